@@ -0,0 +1,449 @@
+#include "pub/com.h"
+#include "pub/error.h"
+#include "pub/string.h"
+#include "pub/dllist.h"
+
+#include "lib/debug.h"
+#include "lib/sync.h"
+
+#include "driver/ide.h"
+#include "driver/clock.h"
+#include "driver/blk.h"
+
+#include "fs/fs.h"
+
+/**
+ * requests wait in a queue per ide channel, since a channel runs one
+ * command at a time. a command is sent only when the channel is idle, so
+ * everything that arrived meanwhile can be chosen from:
+ *
+ *     deadline: the oldest read, then the oldest write, if it has waited
+ *               longer than its expiry time
+ *     c-look:   otherwise the first request at or after the sector where
+ *               the last command ended, going back to the lowest one
+ *               when there is none
+ *
+ * the requests next to the chosen one on the disk are sent in the same
+ * command as long as it can hold them, in either direction.
+ *
+ * while the queue is plugged nothing is sent, so that a batch being built
+ * is seen all at once. a waiter unplugs its own channel, it would wait
+ * forever otherwise.
+ **/
+
+typedef struct {
+    dllist_t sorted;                // waiting, by drive and sector
+    dllist_t fifo[2];               // waiting, by arrival, reads and writes
+    dllist_t sent;                  // the requests of the command in flight
+    bool busy;
+    ide_request_t cmd;
+    ide_iovec_t iov[BLK_MAX_NIOV];
+    unsigned short ideno;           // where the last command ended
+    uint32_t pos;
+} blk_queue_t;
+
+static blk_queue_t blk_queues[IDE_NCHAN];
+static size_t blk_plugged = 0;
+
+typedef struct {
+    size_t nreq;
+    size_t ncmd;
+    size_t nmerge;                  // requests sent with another one
+    size_t nexpire;                 // commands chosen by a deadline
+    size_t nseek;                   // commands not starting where the last one ended
+} blk_stat_t;
+
+static blk_stat_t blk_stat;
+
+static void check_blk();
+
+void blk_init()
+{
+    size_t i;
+    
+    for (i = 0; i < IDE_NCHAN; i++) {
+        dllist_init(&blk_queues[i].sorted);
+        dllist_init(&blk_queues[i].fifo[0]);
+        dllist_init(&blk_queues[i].fifo[1]);
+        dllist_init(&blk_queues[i].sent);
+    }
+    
+    if (ide_device_valid(0)) {
+        check_blk();
+    }
+}
+
+// whether req comes before sector secno of ideno in the sorted queue
+C0RE_INLINE
+bool blk_before(blk_request_t *req, unsigned short ideno, uint32_t secno)
+{
+    return req->ideno < ideno || (req->ideno == ideno && req->secno < secno);
+}
+
+// whether b starts where a ends, and goes the same way
+C0RE_INLINE
+bool blk_adjacent(blk_request_t *a, blk_request_t *b)
+{
+    return a->ideno == b->ideno && a->write == b->write &&
+           a->secno + a->nsecs == b->secno;
+}
+
+// whether req fits in a command of nsecs sectors, niov pieces reachable
+// as kinds, the command takes it in if so
+static bool blk_fit(blk_request_t *req, size_t *nsecs, size_t *niov, int *kinds)
+{
+    if (*nsecs + req->nsecs > IDE_MAX_NSECS || *niov + req->niov > BLK_MAX_NIOV ||
+        !(*kinds & req->kinds)) {
+        return 0;
+    }
+    
+    *nsecs += req->nsecs;
+    *niov += req->niov;
+    *kinds &= req->kinds;
+    
+    return 1;
+}
+
+// the request to send next, see the top
+static blk_request_t *blk_pick(blk_queue_t *q)
+{
+    long now = clock_tick();
+    blk_request_t *req;
+    dllist_t *dll;
+    int dir;
+    
+    for (dir = 0; dir < 2; dir++) {
+        if (!dllist_empty(&q->fifo[dir])) {
+            req = dll2blk(dllist_next(&q->fifo[dir]), fifo_link);
+    
+            if (now - req->deadline >= 0) {
+                blk_stat.nexpire++;
+                return req;
+            }
+        }
+    }
+    
+    for (dll = dllist_next(&q->sorted); dll != &q->sorted; dll = dllist_next(dll)) {
+        req = dll2blk(dll, sort_link);
+    
+        if (!blk_before(req, q->ideno, q->pos)) {
+            return req;
+        }
+    }
+    
+    return dll2blk(dllist_next(&q->sorted), sort_link);
+}
+
+static void blk_complete(ide_request_t *cmd);
+
+// send the next command of q if the channel is idle, interrupts off
+// parameters:
+//  force: send it even if the queue is plugged
+static void blk_dispatch(blk_queue_t *q, bool force)
+{
+    blk_request_t *first, *last, *req;
+    size_t nsecs, niov, i;
+    dllist_t *dll;
+    int kinds, r;
+    
+    if (q->busy || dllist_empty(&q->sorted) || (blk_plugged && !force)) {
+        return;
+    }
+    
+    first = last = blk_pick(q);
+    nsecs = first->nsecs;
+    niov = first->niov;
+    kinds = first->kinds;
+    
+    // take in the neighbours on both sides while the command holds them
+    while ((dll = dllist_prev(&first->sort_link)) != &q->sorted) {
+        req = dll2blk(dll, sort_link);
+    
+        if (!blk_adjacent(req, first) || !blk_fit(req, &nsecs, &niov, &kinds)) {
+            break;
+        }
+    
+        first = req;
+    }
+    
+    while ((dll = dllist_next(&last->sort_link)) != &q->sorted) {
+        req = dll2blk(dll, sort_link);
+    
+        if (!blk_adjacent(last, req) || !blk_fit(req, &nsecs, &niov, &kinds)) {
+            break;
+        }
+    
+        last = req;
+    }
+    
+    memset(&q->cmd, 0, sizeof(q->cmd));
+    q->cmd.ideno = first->ideno;
+    q->cmd.secno = first->secno;
+    q->cmd.write = first->write;
+    q->cmd.iov = q->iov;
+    q->cmd.done = blk_complete;
+    q->cmd.data = q;
+    
+    if (first->ideno != q->ideno || first->secno != q->pos) {
+        blk_stat.nseek++;
+    }
+    
+    blk_stat.ncmd++;
+    q->ideno = first->ideno;
+    q->pos = first->secno + nsecs;
+    
+    // move them to the command, with their pieces of memory in order
+    for (req = first; ; req = dll2blk(dll, sort_link)) {
+        dll = dllist_next(&req->sort_link);
+    
+        dllist_del(&req->sort_link);
+        dllist_del(&req->fifo_link);
+        dllist_add_before(&q->sent, &req->sort_link);
+    
+        for (i = 0; i < req->niov; i++) {
+            q->iov[q->cmd.niov++] = req->iov[i];
+        }
+    
+        if (req != first) {
+            blk_stat.nmerge++;
+        }
+    
+        if (req == last) {
+            break;
+        }
+    }
+    
+    q->busy = 1;
+    
+    if ((r = ide_submit(&q->cmd)) != 0) {
+        q->cmd.error = r;
+        blk_complete(&q->cmd);
+    }
+}
+
+// the command of a queue is over, tell the owners of its requests
+static void blk_complete(ide_request_t *cmd)
+{
+    blk_queue_t *q = cmd->data;
+    blk_request_t *req;
+    dllist_t *dll;
+    
+    // still busy, requests submitted by done wait for the next command
+    while ((dll = dllist_next(&q->sent)) != &q->sent) {
+        req = dll2blk(dll, sort_link);
+        dllist_del(dll);
+    
+        req->error = cmd->error;
+        req->finished = 1;
+    
+        if (req->done) {
+            req->done(req);
+        }
+    }
+    
+    q->busy = 0;
+    blk_dispatch(q, 0);
+}
+
+// blk_submit - queue req, it's sent at once if the channel is idle and the
+//            - queue isn't plugged. done may be called before it returns
+// return value: 0 if req is queued, -E_INVAL if the drive or the range is
+//               wrong, done is not called then
+int blk_submit(blk_request_t *req)
+{
+    blk_queue_t *q;
+    size_t nsecs = 0, i;
+    dllist_t *dll;
+    
+    if (!ide_device_valid(req->ideno) || req->niov > BLK_MAX_NIOV) {
+        return -E_INVAL;
+    }
+    
+    req->kinds = BLK_IOV_PHYS | BLK_IOV_MAPPED;
+    
+    for (i = 0; i < req->niov; i++) {
+        nsecs += req->iov[i].nsecs;
+    
+        if (!req->iov[i].pa) {
+            req->kinds &= ~BLK_IOV_PHYS;
+        }
+    
+        if (!req->iov[i].base) {
+            req->kinds &= ~BLK_IOV_MAPPED;
+        }
+    }
+    
+    if (!req->kinds || nsecs == 0 || nsecs > IDE_MAX_NSECS ||
+        req->secno >= ide_device_size(req->ideno) ||
+        nsecs > ide_device_size(req->ideno) - req->secno) {
+        return -E_INVAL;
+    }
+    
+    req->nsecs = nsecs;
+    req->finished = 0;
+    req->error = 0;
+    req->deadline = clock_tick() + (req->write ? BLK_WRITE_EXPIRE : BLK_READ_EXPIRE);
+    
+    q = &blk_queues[IDE_CHAN(req->ideno)];
+    
+    no_intr_block({
+        // new requests mostly go at the end, look from there
+        dll = dllist_prev(&q->sorted);
+    
+        while (dll != &q->sorted && !blk_before(dll2blk(dll, sort_link), req->ideno, req->secno)) {
+            dll = dllist_prev(dll);
+        }
+    
+        dllist_add_after(dll, &req->sort_link);
+        dllist_add_before(&q->fifo[req->write], &req->fifo_link);
+    
+        blk_stat.nreq++;
+        blk_dispatch(q, 0);
+    });
+    
+    return 0;
+}
+
+// blk_wait - wait until req is over, its channel is unplugged meanwhile.
+//          - the cpu sleeps with interrupts on, polls the drive otherwise
+// return value: the error of req
+int blk_wait(blk_request_t *req)
+{
+    blk_queue_t *q = &blk_queues[IDE_CHAN(req->ideno)];
+    bool intr_flag;
+    
+    intr_save(intr_flag);
+    
+    while (1) {
+        blk_dispatch(q, 1);
+    
+        if (req->finished) {
+            break;
+        }
+    
+        if (intr_flag) {
+            // sti takes effect after hlt starts, no interrupt is missed
+            asm volatile ("sti; hlt; cli" ::: "memory");
+        }
+    
+        ide_poll(req->ideno);
+    }
+    
+    intr_restore(intr_flag);
+    
+    return req->error;
+}
+
+// blk_plug - hold back new commands until the matching blk_unplug, plugs
+//          - nest
+void blk_plug()
+{
+    no_intr_block(blk_plugged++);
+}
+
+void blk_unplug()
+{
+    size_t i;
+    
+    no_intr_block({
+        assert(blk_plugged);
+    
+        if (--blk_plugged == 0) {
+            for (i = 0; i < IDE_NCHAN; i++) {
+                blk_dispatch(&blk_queues[i], 0);
+            }
+        }
+    });
+}
+
+void blk_reset_stat()
+{
+    no_intr_block(memset(&blk_stat, 0, sizeof(blk_stat)));
+}
+
+void blk_dump_stat()
+{
+    kprintf(DBG_TAB "blk requests %u, commands %u, merged %u, expired %u, seeks %u\n",
+            blk_stat.nreq, blk_stat.ncmd, blk_stat.nmerge, blk_stat.nexpire, blk_stat.nseek);
+}
+
+static size_t check_blk_order[4], check_blk_ndone;
+
+static void check_blk_done(blk_request_t *req)
+{
+    check_blk_order[check_blk_ndone++] = req->secno;
+}
+
+// reads of the boot disk, queued while plugged
+static void check_blk()
+{
+    static uint8_t buf[4][FS_SECTOR_SIZE], copy[3][FS_SECTOR_SIZE];
+    static const uint32_t secnos[4] = { 2, 5, 0, 1 };
+    blk_queue_t *q = &blk_queues[0];
+    ide_iovec_t iov[4];
+    blk_request_t req[4];
+    blk_stat_t stat = blk_stat;
+    size_t i;
+    
+    assert(ide_read_secs(0, 0, copy, 3) == 0);
+    
+    memset(req, 0, sizeof(req));
+    check_blk_ndone = 0;
+    
+    // 0, 1 and 2 go in one command, 5 in another one
+    blk_plug();
+    
+    for (i = 0; i < 4; i++) {
+        iov[i].base = buf[i];
+        iov[i].nsecs = 1;
+        iov[i].pa = 0;
+    
+        req[i].ideno = 0;
+        req[i].secno = secnos[i];
+        req[i].iov = &iov[i];
+        req[i].niov = 1;
+        req[i].done = check_blk_done;
+        assert(blk_submit(&req[i]) == 0);
+    }
+    
+    assert(!q->busy);
+    blk_unplug();
+    
+    for (i = 0; i < 4; i++) {
+        assert(blk_wait(&req[i]) == 0);
+    }
+    
+    assert(blk_stat.ncmd - stat.ncmd == 2 && blk_stat.nmerge - stat.nmerge == 2);
+    assert(check_blk_ndone == 4);
+    
+    // nothing was sent on this channel before, so it starts from sector 0
+    assert(check_blk_order[0] == 0 && check_blk_order[1] == 1 &&
+           check_blk_order[2] == 2 && check_blk_order[3] == 5);
+    
+    assert(memcmp(buf[2], copy[0], FS_SECTOR_SIZE) == 0);
+    assert(memcmp(buf[3], copy[1], FS_SECTOR_SIZE) == 0);
+    assert(memcmp(buf[0], copy[2], FS_SECTOR_SIZE) == 0);
+    
+    // after 5, c-look would take 9 before 3 unless 3 has expired
+    blk_plug();
+    check_blk_ndone = 0;
+    
+    for (i = 0; i < 2; i++) {
+        req[i].secno = i ? 9 : 3;
+        assert(blk_submit(&req[i]) == 0);
+    }
+    
+    req[0].deadline = clock_tick() - 1;
+    blk_unplug();
+    
+    assert(blk_wait(&req[0]) == 0 && blk_wait(&req[1]) == 0);
+    assert(check_blk_ndone == 2 && check_blk_order[0] == 3 && check_blk_order[1] == 9);
+    
+    // past the end of the drive
+    req[0].secno = ide_device_size(0);
+    assert(blk_submit(&req[0]) == -E_INVAL);
+    
+    blk_reset_stat();
+    
+    trace("check success: blk");
+}
@@ -0,0 +1,64 @@
+#ifndef _KERNEL_DRIVER_BLK_H_
+#define _KERNEL_DRIVER_BLK_H_
+
+#include "pub/com.h"
+#include "pub/dllist.h"
+
+#include "driver/ide.h"
+#include "driver/clock.h"
+
+// ticks a request may wait before it's served ahead of sector order,
+// reads have a fault waiting for them, writes don't
+#define BLK_READ_EXPIRE     (CLOCK_TICK_PER_SEC / 2)
+#define BLK_WRITE_EXPIRE    (CLOCK_TICK_PER_SEC * 5)
+
+// max # of pieces of memory in one command
+#define BLK_MAX_NIOV        IDE_MAX_NSECS
+
+// requests are sent together only if the ide driver can reach all their
+// pieces the same way
+#define BLK_IOV_PHYS        0x1
+#define BLK_IOV_MAPPED      0x2
+
+/**
+ * a transfer of consecutive sectors of a drive through the block queue.
+ * it may be sent to the drive together with its neighbours on the disk
+ * in a single command. done is called from the interrupt(or from
+ * blk_wait) once it's over, iov must stay valid until then.
+ **/
+typedef struct blk_request_tag {
+    unsigned short ideno;
+    uint32_t secno;
+    bool write;
+    const ide_iovec_t *iov;
+    size_t niov;
+    
+    void (*done)(struct blk_request_tag *req);
+    void *data;                 // for done
+    
+    volatile bool finished;
+    int error;
+    
+    // private to the block queue
+    size_t nsecs;
+    int kinds;                  // BLK_IOV_PHYS if all pieces have a pa, BLK_IOV_MAPPED if a base
+    long deadline;              // tick from which it goes first
+    dllist_t sort_link;         // in sector order, or in the command sent
+    dllist_t fifo_link;         // in arrival order among those of its direction
+} blk_request_t;
+
+#define dll2blk(dll, member) \
+    to_struct((dll), blk_request_t, member)
+
+void blk_init();
+
+int blk_submit(blk_request_t *req);
+int blk_wait(blk_request_t *req);
+
+void blk_plug();
+void blk_unplug();
+
+void blk_reset_stat();
+void blk_dump_stat();
+
+#endif
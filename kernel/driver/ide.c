@@ -1,13 +1,19 @@
 #include "pub/com.h"
 #include "pub/x86.h"
+#include "pub/error.h"
+#include "pub/string.h"
 
 #include "lib/io.h"
 #include "lib/debug.h"
+#include "lib/sync.h"
 #include "intr/trap.h"
 
 #include "driver/pic.h"
+#include "driver/pci.h"
 #include "driver/ide.h"
 
+#include "mem/pmm.h"
+
 #include "fs/fs.h"
 
 #define ISA_DATA                0x00
@@ -31,6 +37,8 @@
 #define IDE_CMD_READ            0x20
 #define IDE_CMD_WRITE           0x30
 #define IDE_CMD_IDENTIFY        0xEC
+#define IDE_CMD_READ_DMA        0xC8
+#define IDE_CMD_WRITE_DMA       0xCA
 
 #define IDE_IDENT_SECTORS       20
 #define IDE_IDENT_MODEL         54
@@ -39,20 +47,36 @@
 #define IDE_IDENT_MAX_LBA       120
 #define IDE_IDENT_MAX_LBA_EXT   200
 
+#define IDE_CAP_DMA             0x100
+#define IDE_CAP_LBA             0x200
+
+// bus master registers, the secondary channel's are 8 bytes after
+#define BM_COMMAND              0x00
+#define BM_STATUS               0x02
+#define BM_PRDT                 0x04
+#define BM_CHAN_SIZE            0x08
+
+#define BM_CMD_START            0x01
+#define BM_CMD_READ             0x08    // the controller writes to memory
+
+#define BM_ST_ACTIVE            0x01
+#define BM_ST_ERR               0x02
+#define BM_ST_INTR              0x04    // write 1 to clear ERR and INTR
+
 #define IO_BASE0                0x1F0
 #define IO_BASE1                0x170
 #define IO_CTRL0                0x3F4
 #define IO_CTRL1                0x374
 
 #define MAX_IDE                 4
-#define MAX_NSECS               128
+#define MAX_NSECS               IDE_MAX_NSECS
 #define MAX_DISK_NSECS          0x10000000U
 #define VALID_IDE(ideno)        (((ideno) >= 0) && ((ideno) < MAX_IDE) && (ide_devices[ideno].valid))
 
 static const struct {
     unsigned short base;        // I/O Base
     unsigned short ctrl;        // Control Base
-} channels[2] = {
+} channels[IDE_NCHAN] = {
     {IO_BASE0, IO_CTRL0},
     {IO_BASE1, IO_CTRL1},
 };
@@ -64,9 +88,57 @@ static struct ide_device {
     unsigned char valid;        // 0 or 1 (If Device Really Exists)
     unsigned int sets;          // commend sets supported
     unsigned int size;          // size in sectors
+    unsigned char dma;          // supports multiword dma
     unsigned char model[41];    // model in string
 } ide_devices[MAX_IDE];
 
+/**
+ * requests are queued per channel, since the two drives of a channel share
+ * its registers. the head is the one the drive is working on, the others
+ * are started in order as it finishes.
+ **/
+static struct {
+    ide_request_t *head, *tail;
+} ide_queues[IDE_NCHAN];
+
+/**
+ * bus master dma of a PIIX compatible controller: the controller walks a
+ * table of physical regions and moves the data itself, the drive raises a
+ * single interrupt at the end of the command. a region may not cross a
+ * 64k boundary, so a piece of an iovec takes at most two of them. both
+ * tables are kept in the kernel image, below 4G and within a page.
+ **/
+typedef struct {
+    uint32_t addr;
+    uint16_t count;             // in bytes, 0 for 64k
+    uint16_t flags;
+} ide_prd_t;
+
+#define PRD_EOT                 0x8000  // the last region of the table
+#define PRD_BOUNDARY            0x10000
+#define IDE_MAX_PRD             (MAX_NSECS * 2)
+
+static ide_prd_t ide_prdt[IDE_NCHAN][IDE_MAX_PRD] C0RE_ALIGNED(PAGE_SIZE);
+
+static unsigned short ide_bmbase[IDE_NCHAN];    // 0 if the channel can't do dma
+static bool ide_dma_enabled = 0;
+
+// transfers of either mode, for comparing them
+typedef struct {
+    size_t ncmd;
+    size_t nsecs;
+    size_t nintr;
+    uint64_t cycles;            // from the command to the end of it
+    uint64_t busy;              // spent by the cpu moving the data or setting up the controller
+} ide_stat_t;
+
+#define IDE_STAT_PIO            0
+#define IDE_STAT_DMA            1
+
+static ide_stat_t ide_stat[2];
+
+static void check_ide();
+
 static int ide_wait_ready(unsigned short iobase, bool check_error)
 {
     int r;
@@ -80,6 +152,35 @@ static int ide_wait_ready(unsigned short iobase, bool check_error)
     return 0;
 }
 
+// find the bus master registers of the ide controller and let it master
+static void ide_dma_init()
+{
+    pci_func_t f;
+    uint32_t bar, cmd;
+    
+    if (!pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, &f)) {
+        kprintf("ide: no pci controller, pio only\n");
+        return;
+    }
+    
+    // bar 4 holds the bus master registers, always in i/o space
+    if (!((bar = pci_read(&f, PCI_BAR(4))) & PCI_BAR_IO) || !(bar & PCI_BAR_IO_MASK)) {
+        kprintf("ide: controller %d:%d.%d can't do bus master dma, pio only\n",
+                f.bus, f.dev, f.func);
+        return;
+    }
+    
+    cmd = pci_read(&f, PCI_COMMAND) & 0xFFFF;
+    pci_write(&f, PCI_COMMAND, cmd | PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+    
+    ide_bmbase[0] = bar & PCI_BAR_IO_MASK;
+    ide_bmbase[1] = ide_bmbase[0] + BM_CHAN_SIZE;
+    ide_dma_enabled = 1;
+    
+    kprintf("ide: controller %d:%d.%d, bus master at 0x%x\n",
+            f.bus, f.dev, f.func, ide_bmbase[0]);
+}
+
 void ide_init()
 {
     assert((FS_SECTOR_SIZE % 4) == 0);
@@ -130,7 +231,9 @@ void ide_init()
         ide_devices[ideno].size = sectors;
 
         /* check if supports LBA */
-        assert((*(unsigned short *)(ident + IDE_IDENT_CAPABILITIES) & 0x200) != 0);
+        unsigned short caps = *(unsigned short *)(ident + IDE_IDENT_CAPABILITIES);
+        assert((caps & IDE_CAP_LBA) != 0);
+        ide_devices[ideno].dma = !!(caps & IDE_CAP_DMA);
 
         unsigned char *model = ide_devices[ideno].model, *data = ident + IDE_IDENT_MODEL;
         unsigned int i, length = 40;
@@ -149,6 +252,12 @@ void ide_init()
     // enable ide interrupt
     pic_enable(IRQ_IDE1);
     pic_enable(IRQ_IDE2);
+    
+    ide_dma_init();
+    
+    if (VALID_IDE(0)) {
+        check_ide();
+    }
 }
 
 bool ide_device_valid(unsigned short ideno)
@@ -165,8 +274,35 @@ size_t ide_device_size(unsigned short ideno)
     return 0;
 }
 
-int ide_read_secs(unsigned short ideno, uint32_t secno, void *dst, size_t nsecs)
-{ 
+// ide_device_dma - whether transfers with ideno should go by dma, callers
+//                - give physical addresses in their iovecs then
+bool ide_device_dma(unsigned short ideno)
+{
+    return ide_device_valid(ideno) && ide_dma_enabled &&
+           ide_devices[ideno].dma && ide_bmbase[IDE_CHAN(ideno)];
+}
+
+// ide_set_dma - turn dma on or off, pio is used for everything when it's off
+void ide_set_dma(bool enabled)
+{
+    ide_dma_enabled = enabled && ide_bmbase[0];
+}
+
+// total # of sectors in iov
+static size_t ide_iov_nsecs(const ide_iovec_t *iov, size_t niov)
+{
+    size_t nsecs = 0, i;
+    
+    for (i = 0; i < niov; i++) {
+        nsecs += iov[i].nsecs;
+    }
+    
+    return nsecs;
+}
+
+// start a read/write command of nsecs sectors at secno
+static void ide_command(unsigned short ideno, uint32_t secno, size_t nsecs, int cmd)
+{
     assert(nsecs <= MAX_NSECS && VALID_IDE(ideno));
     assert(secno < MAX_DISK_NSECS && secno + nsecs <= MAX_DISK_NSECS);
     
@@ -181,47 +317,445 @@ int ide_read_secs(unsigned short ideno, uint32_t secno, void *dst, size_t nsecs)
     outb(iobase + ISA_CYL_LO, (secno >> 8) & 0xFF);
     outb(iobase + ISA_CYL_HI, (secno >> 16) & 0xFF);
     outb(iobase + ISA_SDH, 0xE0 | ((ideno & 1) << 4) | ((secno >> 24) & 0xF));
-    outb(iobase + ISA_COMMAND, IDE_CMD_READ);
+    outb(iobase + ISA_COMMAND, cmd);
+}
+
+// about 400ns, for the status to be valid after a command or a sector, the
+// alternate status doesn't acknowledge the interrupt
+C0RE_INLINE
+void ide_delay(unsigned short ioctrl)
+{
+    inb(ioctrl + ISA_CTRL);
+    inb(ioctrl + ISA_CTRL);
+    inb(ioctrl + ISA_CTRL);
+    inb(ioctrl + ISA_CTRL);
+}
 
-    int ret = 0;
-    for (; nsecs > 0; nsecs--, dst += FS_SECTOR_SIZE) {
-        if ((ret = ide_wait_ready(iobase, 1)) != 0) {
-            goto out;
+// whether all pieces of req can be reached by the controller. a caller
+// that gave physical addresses only gets dma even if it was turned off
+// since, so ide_dma_enabled is not looked at
+static bool ide_dma_usable(ide_request_t *req)
+{
+    size_t i;
+    
+    if (!ide_devices[req->ideno].dma || !ide_bmbase[IDE_CHAN(req->ideno)]) {
+        return 0;
+    }
+    
+    for (i = 0; i < req->niov; i++) {
+        const ide_iovec_t *iov = &req->iov[i];
+    
+        if (!iov->pa || (iov->pa & 3) ||
+            (uint64_t)iov->pa + iov->nsecs * FS_SECTOR_SIZE > 0x100000000ULL) {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+// fill the region table of chan with the pieces of req
+static void ide_dma_setup(size_t chan, ide_request_t *req)
+{
+    ide_prd_t *prd = ide_prdt[chan];
+    size_t i, n = 0;
+    
+    for (i = 0; i < req->niov; i++) {
+        uint32_t pa = req->iov[i].pa;
+        size_t len = req->iov[i].nsecs * FS_SECTOR_SIZE, part;
+    
+        while (len > 0) {
+            part = PRD_BOUNDARY - (pa & (PRD_BOUNDARY - 1));
+    
+            if (part > len) {
+                part = len;
+            }
+    
+            prd[n].addr = pa;
+            prd[n].count = part & 0xFFFF;
+            prd[n].flags = 0;
+            n++;
+    
+            pa += part;
+            len -= part;
         }
-        insl(iobase, dst, FS_SECTOR_SIZE / sizeof(uint32_t));
     }
+    
+    assert(n > 0 && n <= IDE_MAX_PRD);
+    prd[n - 1].flags = PRD_EOT;
+}
 
-out:
-    return ret;
+// the buffer of the next sector of req, moves it on
+static void *ide_next_sector(ide_request_t *req)
+{
+    void *buf;
+    
+    while (req->off == req->iov[req->cur].nsecs) {
+        req->cur++;
+        req->off = 0;
+    }
+    
+    buf = req->iov[req->cur].base + req->off * FS_SECTOR_SIZE;
+    
+    req->off++;
+    req->nleft--;
+    
+    return buf;
 }
 
-int ide_write_secs(unsigned short ideno, uint32_t secno, const void *src, size_t nsecs)
+static void ide_progress(size_t chan);
+
+// send the command of the head of chan
+static void ide_start(size_t chan)
 {
-    assert(nsecs <= MAX_NSECS && VALID_IDE(ideno));
-    assert(secno < MAX_DISK_NSECS && secno + nsecs <= MAX_DISK_NSECS);
-    unsigned short iobase = IO_BASE(ideno), ioctrl = IO_CTRL(ideno);
+    ide_request_t *req = ide_queues[chan].head;
+    
+    req->begin = rdtsc();
+    
+    if (req->dma) {
+        unsigned short bmbase = ide_bmbase[chan];
+        uint8_t dir = req->write ? 0 : BM_CMD_READ;
+    
+        ide_dma_setup(chan, req);
+    
+        outb(bmbase + BM_COMMAND, dir);
+        outl(bmbase + BM_PRDT, PADDR(ide_prdt[chan]));
+        outb(bmbase + BM_STATUS, inb(bmbase + BM_STATUS) | BM_ST_ERR | BM_ST_INTR);
+    
+        ide_command(req->ideno, req->secno, req->nleft,
+                    req->write ? IDE_CMD_WRITE_DMA : IDE_CMD_READ_DMA);
+        outb(bmbase + BM_COMMAND, dir | BM_CMD_START);
+    
+        ide_stat[IDE_STAT_DMA].busy += rdtsc() - req->begin;
+        return;
+    }
+    
+    ide_command(req->ideno, req->secno, req->nleft,
+                req->write ? IDE_CMD_WRITE : IDE_CMD_READ);
+    
+    if (req->write) {
+        // no interrupt for the first sector, the drive just asks for it
+        ide_delay(IO_CTRL(req->ideno));
+        ide_wait_ready(IO_BASE(req->ideno), 0);
+        ide_progress(chan);
+    }
+}
 
-    ide_wait_ready(iobase, 0);
+// the head of chan is over: start the next one, then tell the owner
+static void ide_finish(size_t chan, int error)
+{
+    ide_request_t *req = ide_queues[chan].head;
+    ide_stat_t *stat = &ide_stat[req->dma ? IDE_STAT_DMA : IDE_STAT_PIO];
+    
+    if (!(ide_queues[chan].head = req->next)) {
+        ide_queues[chan].tail = NULL;
+    }
+    
+    stat->ncmd++;
+    stat->nsecs += ide_iov_nsecs(req->iov, req->niov) - req->nleft;
+    stat->cycles += rdtsc() - req->begin;
+    
+    req->next = NULL;
+    req->error = error;
+    req->finished = 1;
+    
+    if (ide_queues[chan].head) {
+        ide_start(chan);
+    }
+    
+    if (req->done) {
+        req->done(req);
+    }
+}
 
-    // generate interrupt
-    outb(ioctrl + ISA_CTRL, 0);
-    outb(iobase + ISA_SECCNT, nsecs);
-    outb(iobase + ISA_SECTOR, secno & 0xFF);
-    outb(iobase + ISA_CYL_LO, (secno >> 8) & 0xFF);
-    outb(iobase + ISA_CYL_HI, (secno >> 16) & 0xFF);
-    outb(iobase + ISA_SDH, 0xE0 | ((ideno & 1) << 4) | ((secno >> 24) & 0xF));
-    outb(iobase + ISA_COMMAND, IDE_CMD_WRITE);
+// the dma command of the head of chan is over once the controller says so
+static void ide_dma_progress(size_t chan)
+{
+    ide_request_t *req = ide_queues[chan].head;
+    unsigned short bmbase = ide_bmbase[chan];
+    uint8_t bmstatus = inb(bmbase + BM_STATUS);
+    int status;
+    
+    if (!(bmstatus & (BM_ST_INTR | BM_ST_ERR))) {
+        return;
+    }
+    
+    // stop the controller, then acknowledge the drive and the controller
+    outb(bmbase + BM_COMMAND, 0);
+    status = inb(channels[chan].base + ISA_STATUS);
+    outb(bmbase + BM_STATUS, bmstatus | BM_ST_ERR | BM_ST_INTR);
+    
+    if ((bmstatus & BM_ST_ERR) || (status & (IDE_DF | IDE_ERR))) {
+        ide_finish(chan, -1);
+    } else {
+        req->nleft = 0;
+        ide_finish(chan, 0);
+    }
+}
 
-    int ret = 0;
+// move the head of chan on as far as the drive allows, interrupts off.
+// reading the status acknowledges the interrupt, so it's fine to call it
+// either from the handler or when polling
+static void ide_progress(size_t chan)
+{
+    ide_request_t *req = ide_queues[chan].head;
+    unsigned short iobase = channels[chan].base;
+    uint64_t begin;
+    int status;
+    
+    if (req && req->dma) {
+        ide_dma_progress(chan);
+        return;
+    }
+    
+    if (!req || ((status = inb(iobase + ISA_STATUS)) & IDE_BSY)) {
+        return;
+    }
     
-    for (; nsecs > 0; nsecs--, src += FS_SECTOR_SIZE) {
-        if ((ret = ide_wait_ready(iobase, 1)) != 0) {
-            goto out;
+    if (status & (IDE_DF | IDE_ERR)) {
+        ide_finish(chan, -1);
+        return;
+    }
+    
+    if (!(status & IDE_DRQ)) {
+        // the last sector written has made it to the disk
+        if (req->write && req->nleft == 0) {
+            ide_finish(chan, 0);
         }
-        
-        outsl(iobase, src, FS_SECTOR_SIZE / sizeof(uint32_t));
+    
+        return;
+    }
+    
+    if (req->nleft == 0) {
+        return;
+    }
+    
+    begin = rdtsc();
+    
+    if (req->write) {
+        outsl(iobase + ISA_DATA, ide_next_sector(req), FS_SECTOR_SIZE / sizeof(uint32_t));
+        ide_stat[IDE_STAT_PIO].busy += rdtsc() - begin;
+        ide_delay(channels[chan].ctrl);
+    } else {
+        insl(iobase + ISA_DATA, ide_next_sector(req), FS_SECTOR_SIZE / sizeof(uint32_t));
+        ide_stat[IDE_STAT_PIO].busy += rdtsc() - begin;
+    
+        if (req->nleft == 0) {
+            ide_finish(chan, 0);
+        }
+    }
+}
+
+// ide_submit - queue req on the channel of its drive, it's started at once
+//            - if the channel is idle. done may be called before it returns
+// return value: 0 if req is queued, -E_INVAL if the drive or the range is
+//               wrong, done is not called then
+int ide_submit(ide_request_t *req)
+{
+    size_t chan, nsecs;
+    
+    nsecs = ide_iov_nsecs(req->iov, req->niov);
+    
+    if (!VALID_IDE(req->ideno) || nsecs == 0 || nsecs > MAX_NSECS ||
+        req->secno >= MAX_DISK_NSECS || req->secno + nsecs > MAX_DISK_NSECS) {
+        return -E_INVAL;
+    }
+    
+    req->dma = ide_dma_usable(req);
+    req->cur = req->off = 0;
+    req->nleft = nsecs;
+    req->next = NULL;
+    req->error = 0;
+    req->finished = 0;
+    
+    chan = IDE_CHAN(req->ideno);
+    
+    no_intr_block({
+        if (ide_queues[chan].tail) {
+            ide_queues[chan].tail->next = req;
+            ide_queues[chan].tail = req;
+        } else {
+            ide_queues[chan].head = ide_queues[chan].tail = req;
+            ide_start(chan);
+        }
+    });
+    
+    return 0;
+}
+
+// ide_wait - wait until req is over. with interrupts on, the cpu sleeps
+//          - until the drive raises one, otherwise the drive is polled
+// return value: the error of req
+int ide_wait(ide_request_t *req)
+{
+    size_t chan = IDE_CHAN(req->ideno);
+    bool intr_flag;
+    
+    intr_save(intr_flag);
+    
+    while (!req->finished) {
+        if (intr_flag) {
+            // sti takes effect after hlt starts, no interrupt is missed
+            asm volatile ("sti; hlt; cli" ::: "memory");
+        }
+    
+        // also covers an interrupt taken by someone else's poll
+        ide_progress(chan);
+    }
+    
+    intr_restore(intr_flag);
+    
+    return req->error;
+}
+
+// ide_poll - move the requests of the channel of ideno on without waiting
+//          - for its interrupt, with interrupts off
+void ide_poll(unsigned short ideno)
+{
+    ide_progress(IDE_CHAN(ideno));
+}
+
+// ide_intr - handler of the interrupt of a channel
+void ide_intr(unsigned int irq)
+{
+    size_t chan = irq == IRQ_IDE1 ? 0 : 1;
+    ide_request_t *req = ide_queues[chan].head;
+    
+    if (req) {
+        ide_stat[req->dma ? IDE_STAT_DMA : IDE_STAT_PIO].nintr++;
+    }
+    
+    ide_progress(chan);
+}
+
+void ide_reset_stat()
+{
+    no_intr_block(memset(ide_stat, 0, sizeof(ide_stat)));
+}
+
+// ide_dump_stat - print the transfers of either mode, with the cycles the
+//               - cpu spent on them
+void ide_dump_stat()
+{
+    static const char *names[] = { "pio", "dma" };
+    int i;
+    
+    kprintf(DBG_TAB "ide dma: %s\n", !ide_bmbase[0] ? "not available" :
+                                     ide_dma_enabled ? "on" : "off");
+    
+    for (i = 0; i < 2; i++) {
+        uint64_t avg = ide_stat[i].cycles;
+    
+        if (ide_stat[i].ncmd) {
+            do_div(avg, ide_stat[i].ncmd);
+        }
+    
+        kprintf(DBG_TAB "ide %s commands %u, sectors %u, interrupts %u, cycles %llu, "
+                "avg %llu, cpu %llu\n", names[i], ide_stat[i].ncmd, ide_stat[i].nsecs,
+                ide_stat[i].nintr, ide_stat[i].cycles, avg, ide_stat[i].busy);
     }
+}
+
+// submit a request on the stack and wait for it
+static int ide_rw_secsv(unsigned short ideno, uint32_t secno, bool write,
+                        const ide_iovec_t *iov, size_t niov)
+{
+    ide_request_t req;
+    int ret;
+    
+    memset(&req, 0, sizeof(req));
+    req.ideno = ideno;
+    req.secno = secno;
+    req.write = write;
+    req.iov = iov;
+    req.niov = niov;
+    
+    if ((ret = ide_submit(&req)) != 0) {
+        return ret;
+    }
+    
+    return ide_wait(&req);
+}
+
+// ide_read_secsv - read consecutive sectors starting at secno into
+//                - the pieces of iov in order, with a single command
+int ide_read_secsv(unsigned short ideno, uint32_t secno, const ide_iovec_t *iov, size_t niov)
+{
+    return ide_rw_secsv(ideno, secno, 0, iov, niov);
+}
+
+// ide_write_secsv - write the pieces of iov in order to consecutive
+//                 - sectors starting at secno, with a single command
+int ide_write_secsv(unsigned short ideno, uint32_t secno, const ide_iovec_t *iov, size_t niov)
+{
+    return ide_rw_secsv(ideno, secno, 1, iov, niov);
+}
+
+int ide_read_secs(unsigned short ideno, uint32_t secno, void *dst, size_t nsecs)
+{
+    ide_iovec_t iov = { dst, nsecs };
+    return ide_read_secsv(ideno, secno, &iov, 1);
+}
+
+int ide_write_secs(unsigned short ideno, uint32_t secno, const void *src, size_t nsecs)
+{
+    ide_iovec_t iov = { (void *)src, nsecs };
+    return ide_write_secsv(ideno, secno, &iov, 1);
+}
+
+static size_t check_ide_order[2], check_ide_ndone;
+
+static void check_ide_done(ide_request_t *req)
+{
+    check_ide_order[check_ide_ndone++] = (size_t)req->data;
+}
 
-out:
-    return ret;
+// two reads of the boot sector queued back to back, the second one waits
+// for the first. then once more by dma if it's there
+static void check_ide()
+{
+    static uint8_t buf[2][FS_SECTOR_SIZE] C0RE_ALIGNED(FS_SECTOR_SIZE);
+    ide_iovec_t iov[2] = { { buf[0], 1 }, { buf[1], 1 } };
+    ide_request_t req[2];
+    size_t i;
+    
+    memset(req, 0, sizeof(req));
+    check_ide_ndone = 0;
+    
+    for (i = 0; i < 2; i++) {
+        req[i].ideno = 0;
+        req[i].iov = &iov[i];
+        req[i].niov = 1;
+        req[i].done = check_ide_done;
+        req[i].data = (void *)i;
+        assert(ide_submit(&req[i]) == 0);
+    }
+    
+    assert(ide_wait(&req[1]) == 0);
+    assert(req[0].finished && req[0].error == 0);
+    assert(check_ide_ndone == 2 && check_ide_order[0] == 0 && check_ide_order[1] == 1);
+    
+    assert(memcmp(buf[0], buf[1], FS_SECTOR_SIZE) == 0);
+    assert(buf[0][510] == 0x55 && buf[0][511] == 0xAA);
+    
+    if (ide_device_dma(0)) {
+        memset(buf[1], 0, FS_SECTOR_SIZE);
+        iov[1].pa = PADDR(buf[1]);
+        req[1].done = NULL;
+    
+        assert(ide_submit(&req[1]) == 0 && req[1].dma);
+        assert(ide_wait(&req[1]) == 0);
+        assert(memcmp(buf[0], buf[1], FS_SECTOR_SIZE) == 0);
+    }
+    
+    // nothing to transfer, or past the end of the addressable range
+    iov[0].nsecs = 0;
+    assert(ide_submit(&req[0]) == -E_INVAL);
+    iov[0].nsecs = 1;
+    req[0].secno = MAX_DISK_NSECS;
+    assert(ide_submit(&req[0]) == -E_INVAL);
+    
+    ide_reset_stat();
+    
+    trace("check success: ide");
 }
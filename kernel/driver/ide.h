@@ -3,11 +3,68 @@
 
 #include "pub/com.h"
 
+#include "mem/mmu.h"
+
+#define IDE_MAX_NSECS 128 // max # of sectors in one command
+
+// two drives on each channel, one command at a time on a channel
+#define IDE_NCHAN 2
+#define IDE_CHAN(ideno) ((ideno) >> 1)
+
+// a piece of memory taking part in a vectored transfer. pa is for dma, the
+// transfer falls back to pio through base if a piece has none. base may be
+// NULL if all pieces have a pa and the drive can do dma
+typedef struct {
+    void *base;
+    size_t nsecs;
+    paddr_t pa;                 // physical address of the piece, 0 if unknown
+} ide_iovec_t;
+
+/**
+ * an asynchronous transfer: the command is started when the channel is
+ * free, the interrupt handler moves it on sector by sector, and done is
+ * called from the interrupt(or from ide_wait) once it's over. iov must
+ * stay valid until then.
+ **/
+typedef struct ide_request_tag {
+    unsigned short ideno;
+    uint32_t secno;
+    bool write;
+    const ide_iovec_t *iov;
+    size_t niov;
+    
+    void (*done)(struct ide_request_tag *req);
+    void *data;                 // for done
+    
+    volatile bool finished;
+    int error;                  // 0, or -1 if the drive failed
+    
+    // private to the driver
+    bool dma;
+    size_t cur, off;            // the next sector goes to iov[cur] at sector off
+    size_t nleft;               // sectors not transferred yet
+    uint64_t begin;             // tsc when it was started
+    struct ide_request_tag *next;
+} ide_request_t;
+
 void ide_init();
 bool ide_device_valid(unsigned short ideno);
 size_t ide_device_size(unsigned short ideno);
+bool ide_device_dma(unsigned short ideno);
+
+int ide_submit(ide_request_t *req);
+int ide_wait(ide_request_t *req);
+void ide_intr(unsigned int irq);
+void ide_poll(unsigned short ideno);
+
+void ide_set_dma(bool enabled);
+void ide_reset_stat();
+void ide_dump_stat();
 
 int ide_read_secs(unsigned short ideno, uint32_t secno, void *dst, size_t nsecs);
 int ide_write_secs(unsigned short ideno, uint32_t secno, const void *src, size_t nsecs);
 
+int ide_read_secsv(unsigned short ideno, uint32_t secno, const ide_iovec_t *iov, size_t niov);
+int ide_write_secsv(unsigned short ideno, uint32_t secno, const ide_iovec_t *iov, size_t niov);
+
 #endif
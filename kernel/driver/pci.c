@@ -0,0 +1,78 @@
+#include "pub/com.h"
+#include "pub/x86.h"
+
+#include "lib/debug.h"
+
+#include "driver/pci.h"
+
+/**
+ * configuration space through mechanism #1: the address of a register goes
+ * to CONFIG_ADDRESS, then it's read or written at CONFIG_DATA. only what's
+ * needed to find a controller and turn it on is here.
+ **/
+
+#define PCI_CONFIG_ADDRESS      0xCF8
+#define PCI_CONFIG_DATA         0xCFC
+
+#define PCI_MAX_BUS             256
+#define PCI_MAX_DEV             32
+#define PCI_MAX_FUNC            8
+
+#define PCI_HEADER_MULTI        0x800000 // in PCI_HEADER, the device has several functions
+
+#define PCI_NO_VENDOR           0xFFFF
+
+C0RE_INLINE
+void pci_select(const pci_func_t *f, uint8_t reg)
+{
+    outl(PCI_CONFIG_ADDRESS, 0x80000000 | (f->bus << 16) | (f->dev << 11) |
+                             (f->func << 8) | (reg & 0xFC));
+}
+
+uint32_t pci_read(const pci_func_t *f, uint8_t reg)
+{
+    pci_select(f, reg);
+    return inl(PCI_CONFIG_DATA);
+}
+
+void pci_write(const pci_func_t *f, uint8_t reg, uint32_t val)
+{
+    pci_select(f, reg);
+    outl(PCI_CONFIG_DATA, val);
+}
+
+// pci_find_class - look for the first function of class and subclass
+// return value: true if one is found, it's stored in f
+bool pci_find_class(uint8_t class, uint8_t subclass, pci_func_t *f)
+{
+    size_t bus, dev, func, nfunc;
+    uint32_t cls;
+    
+    for (bus = 0; bus < PCI_MAX_BUS; bus++) {
+        for (dev = 0; dev < PCI_MAX_DEV; dev++) {
+            f->bus = bus, f->dev = dev, f->func = 0;
+    
+            if ((pci_read(f, PCI_ID) & 0xFFFF) == PCI_NO_VENDOR) {
+                continue;
+            }
+    
+            nfunc = pci_read(f, PCI_HEADER) & PCI_HEADER_MULTI ? PCI_MAX_FUNC : 1;
+    
+            for (func = 0; func < nfunc; func++) {
+                f->func = func;
+    
+                if ((pci_read(f, PCI_ID) & 0xFFFF) == PCI_NO_VENDOR) {
+                    continue;
+                }
+    
+                cls = pci_read(f, PCI_CLASS);
+    
+                if ((cls >> 24) == class && ((cls >> 16) & 0xFF) == subclass) {
+                    return 1;
+                }
+            }
+        }
+    }
+    
+    return 0;
+}
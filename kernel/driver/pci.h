@@ -0,0 +1,32 @@
+#ifndef _KERNEL_DRIVER_PCI_H_
+#define _KERNEL_DRIVER_PCI_H_
+
+#include "pub/com.h"
+
+// configuration space registers, all read 32 bits at a time
+#define PCI_ID                  0x00    // device in the high half, vendor in the low
+#define PCI_COMMAND             0x04    // status in the high half
+#define PCI_CLASS               0x08    // class, subclass, prog if, revision
+#define PCI_HEADER              0x0C    // header type in bits 16-23
+#define PCI_BAR(n)              (0x10 + (n) * 4)
+
+#define PCI_COMMAND_IO          0x1
+#define PCI_COMMAND_MASTER      0x4
+
+#define PCI_BAR_IO              0x1     // i/o space, the address is in the other bits
+#define PCI_BAR_IO_MASK         0xFFFFFFFC
+
+#define PCI_CLASS_STORAGE       0x01
+#define PCI_SUBCLASS_IDE        0x01
+
+// a function of a device on a bus
+typedef struct {
+    uint8_t bus, dev, func;
+} pci_func_t;
+
+uint32_t pci_read(const pci_func_t *f, uint8_t reg);
+void pci_write(const pci_func_t *f, uint8_t reg, uint32_t val);
+
+bool pci_find_class(uint8_t class, uint8_t subclass, pci_func_t *f);
+
+#endif
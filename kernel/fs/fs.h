@@ -7,5 +7,6 @@
 #define FS_PAGE_NSECTOR           (PAGE_SIZE / FS_SECTOR_SIZE)
 
 #define FS_SWAP_DEV_NO            1
+#define FS_SWAP2_DEV_NO           2 // optional, striped with the first
 
 #endif
@@ -1,33 +1,299 @@
+#include "pub/string.h"
+#include "pub/x86.h"
+
+#include "lib/debug.h"
+#include "lib/sync.h"
+
 #include "mem/mmu.h"
 
 #include "driver/ide.h"
+#include "driver/blk.h"
 
 #include "fs/fs.h"
 #include "fs/swapfs.h"
 
 #include "mem/swap.h"
 
+// latency of the i/o commands in tsc cycles, for reads and writes
+typedef struct {
+    size_t count;
+    size_t npage;
+    uint64_t cycles;
+    uint32_t max;
+    size_t hist[SWAPFS_NBUCKET]; // hist[i] counts latencies in [2^i, 2^(i + 1))
+} swapfs_stat_t;
+
+static swapfs_stat_t swapfs_stat[2];
+
+#define SWAPFS_STAT_READ    0
+#define SWAPFS_STAT_WRITE   1
+
+static void swapfs_record(int dir, size_t npage, uint64_t begin)
+{
+    swapfs_stat_t *stat = &swapfs_stat[dir];
+    uint64_t cycles = rdtsc() - begin;
+    uint32_t lat = cycles >> 32 ? 0xffffffff : (uint32_t)cycles;
+    
+    stat->count++;
+    stat->npage += npage;
+    stat->cycles += cycles;
+    stat->hist[lat ? bsrl(lat) : 0]++;
+    
+    if (lat > stat->max) {
+        stat->max = lat;
+    }
+}
+
+/**
+ * ide devices tried as swap areas, the ones missing are skipped. areas of
+ * higher priority are used first, those of the same priority are striped,
+ * see swapslot.c
+ **/
+static const struct {
+    unsigned short ideno;
+    int prio;
+} swapfs_conf[] = {
+    { FS_SWAP_DEV_NO,   0 },
+    { FS_SWAP2_DEV_NO,  0 },
+};
+
+typedef struct {
+    unsigned short ideno;
+    int prio;
+    size_t nslot;           // slot 0 included
+} swapfs_area_t;
+
+static swapfs_area_t swapfs_areas[SWAP_MAX_TYPE];
+static size_t swapfs_narea = 0;
+
 size_t swapfs_init()
 {
+    size_t i, nslot;
+    
     assert((PAGE_SIZE % FS_SECTOR_SIZE) == 0);
+    assert(C0RE_ARRLEN(swapfs_conf) <= SWAP_MAX_TYPE);
+    
+    for (i = 0; i < C0RE_ARRLEN(swapfs_conf); i++) {
+        unsigned short ideno = swapfs_conf[i].ideno;
+    
+        if (!ide_device_valid(ideno)) {
+            continue;
+        }
+    
+        if ((nslot = ide_device_size(ideno) / FS_PAGE_NSECTOR) < SWAPFS_MIN_NSLOT) {
+            trace("swap fs: ide %d too small, %d pages", ideno, nslot);
+            continue;
+        }
     
-    if (!ide_device_valid(FS_SWAP_DEV_NO)) {
+        if (nslot > SWAP_MAX_SLOT_LIMIT) {
+            nslot = SWAP_MAX_SLOT_LIMIT;
+        }
+    
+        swapfs_areas[swapfs_narea].ideno = ideno;
+        swapfs_areas[swapfs_narea].prio = swapfs_conf[i].prio;
+        swapfs_areas[swapfs_narea].nslot = nslot;
+    
+        trace("swap fs: area %d on ide %d, %d pages, priority %d",
+              swapfs_narea, ideno, nslot, swapfs_conf[i].prio);
+    
+        swapfs_narea++;
+    }
+    
+    if (!swapfs_narea) {
         trace("swap fs not available");
-        return 0;
     }
-                                             // NOTE: how many sectors per page
-    return ide_device_size(FS_SWAP_DEV_NO) / (PAGE_SIZE / FS_SECTOR_SIZE);
-           // NOTE: maximum number of pages in the device
+    
+    return swapfs_narea;
+}
+
+// # of slots in area type, slot 0 included
+size_t swapfs_areaNSlot(size_t type)
+{
+    assert(type < swapfs_narea);
+    return swapfs_areas[type].nslot;
+}
+
+int swapfs_areaPrio(size_t type)
+{
+    assert(type < swapfs_narea);
+    return swapfs_areas[type].prio;
+}
+
+// the device and the first sector of the slot entry
+static uint32_t swapfs_locate(swap_entry_t entry, unsigned short *ideno)
+{
+    size_t offset = swap_getOffset(entry);
+    
+    *ideno = swapfs_areas[SWAP_TYPE(offset)].ideno;
+    
+    return SWAP_SLOT(offset) * FS_PAGE_NSECTOR;
+}
+
+// fill iov with n pages. the controller goes to the frames themselves if
+// the drive does dma and it can reach all of them, they are mapped for pio
+// otherwise
+static void swapfs_map(unsigned short ideno, page_t **pages, size_t n, ide_iovec_t *iov)
+{
+    bool dma = ide_device_dma(ideno);
+    size_t i;
+    
+    for (i = 0; i < n && dma; i++) {
+        dma = (uint64_t)page2pa(pages[i]) + PAGE_SIZE <= 0x100000000ULL;
+    }
+    
+    for (i = 0; i < n; i++) {
+        iov[i].base = dma ? NULL : kmap(pages[i]);
+        iov[i].pa = dma ? page2pa(pages[i]) : 0;
+        iov[i].nsecs = FS_PAGE_NSECTOR;
+    }
+}
+
+static void swapfs_unmap(ide_iovec_t *iov, size_t n)
+{
+    size_t i;
+    
+    for (i = 0; i < n; i++) {
+        if (iov[i].base) {
+            kunmap(iov[i].base);
+        }
+    }
+}
+
+// queue io for ideno, it's over at once if the block queue refuses it
+static void swapfs_submit(swapfs_io_t *io, unsigned short ideno, uint32_t secno,
+                          size_t niov, bool write)
+{
+    blk_request_t *req = &io->req;
+    int r;
+    
+    memset(req, 0, sizeof(*req));
+    req->ideno = ideno;
+    req->secno = secno;
+    req->write = write;
+    req->iov = io->iov;
+    req->niov = niov;
+    
+    io->begin = rdtsc();
+    
+    if ((r = blk_submit(req)) != 0) {
+        req->error = r;
+        req->finished = 1;
+    }
+}
+
+// swapfs_start - start moving n pages from or to the slots starting at
+//              - entry, by dma straight into or out of the frames when
+//              - possible. the block queue may send it with its neighbours
+void swapfs_start(swapfs_io_t *io, swap_entry_t entry, page_t **pages, size_t n, bool write)
+{
+    unsigned short ideno;
+    uint32_t secno = swapfs_locate(entry, &ideno);
+    
+    assert(n <= SWAPFS_MAX_NPAGE);
+    
+    swapfs_map(ideno, pages, n, io->iov);
+    swapfs_submit(io, ideno, secno, n, write);
+}
+
+// swapfs_wait - wait until io is over
+// return value: 0 on success, an error otherwise
+int swapfs_wait(swapfs_io_t *io)
+{
+    int ret = io->req.finished ? io->req.error : blk_wait(&io->req);
+    
+    swapfs_record(io->req.write ? SWAPFS_STAT_WRITE : SWAPFS_STAT_READ,
+                  io->req.niov, io->begin);
+    swapfs_unmap(io->iov, io->req.niov);
+    
+    return ret;
 }
 
 int swapfs_read(swap_entry_t entry, page_t *page)
 {
-    return ide_read_secs(FS_SWAP_DEV_NO, swap_getOffset(entry) * FS_PAGE_NSECTOR,
-                         page2kva(page), FS_PAGE_NSECTOR);
+    return swapfs_readv(entry, &page, 1);
+}
+
+// swapfs_readv - read n pages from the slots starting at entry
+int swapfs_readv(swap_entry_t entry, page_t **pages, size_t n)
+{
+    swapfs_io_t io;
+    
+    swapfs_start(&io, entry, pages, n, 0);
+    
+    return swapfs_wait(&io);
 }
 
 int swapfs_write(swap_entry_t entry, page_t *page)
 {
-    return ide_write_secs(FS_SWAP_DEV_NO, swap_getOffset(entry) * FS_PAGE_NSECTOR,
-                          page2kva(page), FS_PAGE_NSECTOR);
+    return swapfs_writev(entry, &page, 1);
+}
+
+// swapfs_writev - write n pages to the slots starting at entry
+int swapfs_writev(swap_entry_t entry, page_t **pages, size_t n)
+{
+    swapfs_io_t io;
+    
+    swapfs_start(&io, entry, pages, n, 1);
+    
+    return swapfs_wait(&io);
+}
+
+// swapfs_writeBuf - write a page worth of kernel memory to the slot entry
+int swapfs_writeBuf(swap_entry_t entry, const void *buf)
+{
+    swapfs_io_t io;
+    unsigned short ideno;
+    uint32_t secno = swapfs_locate(entry, &ideno);
+    
+    io.iov[0].base = (void *)buf;
+    io.iov[0].pa = ide_device_dma(ideno) ? PADDR(buf) : 0;
+    io.iov[0].nsecs = FS_PAGE_NSECTOR;
+    
+    swapfs_submit(&io, ideno, secno, 1, 1);
+    
+    // the buffer is the caller's, nothing to unmap
+    int ret = io.req.finished ? io.req.error : blk_wait(&io.req);
+    
+    swapfs_record(SWAPFS_STAT_WRITE, 1, io.begin);
+    
+    return ret;
+}
+
+void swapfs_resetStat()
+{
+    no_intr_block(memset(swapfs_stat, 0, sizeof(swapfs_stat)));
+    blk_reset_stat();
+}
+
+// swapfs_dumpStat - print the areas, the latency histograms of reads and writes
+//                 - and what the block queue made of them
+void swapfs_dumpStat()
+{
+    static const char *names[] = { "read", "write" };
+    int i, j;
+    
+    for (i = 0; i < swapfs_narea; i++) {
+        kprintf(DBG_TAB "swapfs area %d: ide %d, pages %u, priority %d\n",
+                i, swapfs_areas[i].ideno, swapfs_areas[i].nslot, swapfs_areas[i].prio);
+    }
+    
+    for (i = 0; i < 2; i++) {
+        uint64_t avg = swapfs_stat[i].cycles;
+        
+        if (swapfs_stat[i].count) {
+            do_div(avg, swapfs_stat[i].count);
+        }
+        
+        kprintf(DBG_TAB "swapfs %-5s requests %u, pages %u, cycles %llu, avg %llu, max %u\n",
+                names[i], swapfs_stat[i].count, swapfs_stat[i].npage,
+                swapfs_stat[i].cycles, avg, swapfs_stat[i].max);
+        
+        for (j = 0; j < SWAPFS_NBUCKET; j++) {
+            if (swapfs_stat[i].hist[j]) {
+                kprintf(DBG_TAB DBG_TAB "2^%-2d cycles: %u\n", j, swapfs_stat[i].hist[j]);
+            }
+        }
+    }
+    
+    blk_dump_stat();
 }
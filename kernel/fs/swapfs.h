@@ -4,9 +4,42 @@
 #include "mem/mmu.h"
 #include "mem/swap.h"
 
-// return max swap offset
+#include "driver/ide.h"
+#include "driver/blk.h"
+
+#include "fs/fs.h"
+
+// max # of pages in one transfer
+#define SWAPFS_MAX_NPAGE (IDE_MAX_NSECS / FS_PAGE_NSECTOR)
+
+// one latency bucket for each power of 2 tsc cycles
+#define SWAPFS_NBUCKET 32
+
+// areas smaller than this are not used
+#define SWAPFS_MIN_NSLOT 1024
+
+// a transfer of pages going on, see swapfs_start
+typedef struct {
+    blk_request_t req;
+    ide_iovec_t iov[SWAPFS_MAX_NPAGE];
+    uint64_t begin;             // tsc when it was started
+} swapfs_io_t;
+
+// return # of swap areas found
 size_t swapfs_init();
+size_t swapfs_areaNSlot(size_t type);
+int swapfs_areaPrio(size_t type);
+
 int swapfs_read(swap_entry_t entry, page_t *page);
 int swapfs_write(swap_entry_t entry, page_t *page);
+int swapfs_readv(swap_entry_t entry, page_t **pages, size_t n);
+int swapfs_writev(swap_entry_t entry, page_t **pages, size_t n);
+int swapfs_writeBuf(swap_entry_t entry, const void *buf);
+
+void swapfs_start(swapfs_io_t *io, swap_entry_t entry, page_t **pages, size_t n, bool write);
+int swapfs_wait(swapfs_io_t *io);
+
+void swapfs_resetStat();
+void swapfs_dumpStat();
 
 #endif
@@ -1,15 +1,19 @@
+#include "pub/x86.h"
 #include "pub/string.h"
 
 #include "lib/debug.h"
+#include "lib/monitor.h"
 #include "mem/pmm.h"
 #include "mem/vmm.h"
 #include "mem/swap.h"
+#include "mem/ksm.h"
 
 #include "intr/trap.h"
 
 #include "driver/pic.h"
 #include "driver/clock.h"
 #include "driver/ide.h"
+#include "driver/blk.h"
 
 void c0re_init() {
     // extern char bss_begin[], bss_end[];
@@ -28,13 +32,22 @@ void c0re_init() {
     idt_init();
 
     vmm_init();
+    ksm_init();
 
     ide_init();
+    blk_init();
     swap_init();
     
     clock_init();
  
     intr_enable();
     
-    while (1) ;
+    // idle: do some background work, then wait for the next interrupt
+    while (1) {
+        ksm_scan(KSM_SCAN_NPAGE);
+        swap_reclaimd();
+        swap_sample();
+        monitor_poll();
+        hlt();
+    }
 }
@@ -4,13 +4,16 @@
 
 #include "lib/io.h"
 #include "lib/debug.h"
+#include "lib/monitor.h"
 #include "intr/trap.h"
 
 #include "mem/mmu.h"
 #include "mem/vmm.h"
+#include "mem/swap.h"
 
 #include "driver/console.h"
 #include "driver/clock.h"
+#include "driver/ide.h"
 
 /* *
  * Interrupt descriptor table:
@@ -85,6 +88,7 @@ static void dispatch(trapframe_t *tf)
             // increase a system clock variable
             // some debug util probably
             _clock_inc();
+            swap_timer();
             break;
             
         case IRQ_OFFSET + IRQ_COM1:
@@ -96,7 +100,7 @@ static void dispatch(trapframe_t *tf)
         case IRQ_OFFSET + IRQ_KBD:
             // trace("cur time: %d sec", (int)((double)clock_tick() / CLOCK_TICK_PER_SEC));
             c = cons_getc();
-            if (c) kputc(c); // simple echo
+            if (c) monitor_putc(c); // echoed by the monitor
             // kprintf("kbd [%03d] %c\n", c, c);
             break;
 
@@ -155,7 +159,7 @@ static void dispatch(trapframe_t *tf)
         
         case IRQ_OFFSET + IRQ_IDE1:
         case IRQ_OFFSET + IRQ_IDE2:
-            /* do nothing */
+            ide_intr(tf->tf_trapno - IRQ_OFFSET);
             break;
             
         default:
@@ -0,0 +1,198 @@
+#include "pub/com.h"
+#include "pub/string.h"
+
+#include "lib/io.h"
+#include "lib/debug.h"
+#include "lib/monitor.h"
+
+#include "driver/clock.h"
+#include "driver/ide.h"
+
+#include "mem/vmm.h"
+#include "mem/ksm.h"
+#include "mem/swap.h"
+
+#define MONITOR_BUFSIZE     64
+#define MONITOR_MAXARGS     8
+
+typedef struct {
+    const char *name;
+    const char *desc;
+    void (*func)(int argc, char **argv);
+} monitor_cmd_t;
+
+static void cmd_help(int argc, char **argv);
+static void cmd_fault(int argc, char **argv);
+static void cmd_ide(int argc, char **argv);
+static void cmd_ksm(int argc, char **argv);
+static void cmd_rss(int argc, char **argv);
+static void cmd_swap(int argc, char **argv);
+static void cmd_vmstat(int argc, char **argv);
+
+static const monitor_cmd_t cmds[] = {
+    { "help",   "list all commands",                            cmd_help  },
+    { "fault",  "page fault latency and counters [reset]",     cmd_fault },
+    { "ide",    "pio and dma transfers [on|off|reset]",         cmd_ide   },
+    { "ksm",    "same-page merging stats [on|off]",             cmd_ksm   },
+    { "rss",    "memory usage of all vma sets",                 cmd_rss   },
+    { "swap",   "swap usage, traffic and i/o latency [reset]",  cmd_swap  },
+    { "vmstat", "print swap counters every n ticks [n|off]",    cmd_vmstat },
+};
+
+static char buf[MONITOR_BUFSIZE];
+static size_t buflen = 0;
+
+// the line entered last, run from the idle loop by monitor_poll
+static char line[MONITOR_BUFSIZE];
+static volatile bool linePending = 0;
+
+static void cmd_help(int argc, char **argv)
+{
+    int i;
+    
+    for (i = 0; i < C0RE_ARRLEN(cmds); i++) {
+        kprintf(DBG_TAB "%-8s %s\n", cmds[i].name, cmds[i].desc);
+    }
+}
+
+static void cmd_fault(int argc, char **argv)
+{
+    extern vma_set_t *c0re_check_vma_set;
+    
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        vmm_resetFaultStat();
+        return;
+    }
+    
+    vmm_dumpFaultStat(c0re_check_vma_set);
+}
+
+static void cmd_ide(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        ide_reset_stat();
+        return;
+    }
+    
+    if (argc > 1) {
+        ide_set_dma(strcmp(argv[1], "off") != 0);
+    }
+    
+    ide_dump_stat();
+}
+
+static void cmd_ksm(int argc, char **argv)
+{
+    if (argc > 1) {
+        ksm_setEnabled(strcmp(argv[1], "off") != 0);
+    }
+    
+    ksm_dumpStat();
+}
+
+static void cmd_rss(int argc, char **argv)
+{
+    vmm_dumpSetStat();
+}
+
+static void cmd_swap(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        swap_resetStat();
+        return;
+    }
+    
+    swap_dumpStat();
+}
+
+static void cmd_vmstat(int argc, char **argv)
+{
+    long ticks = CLOCK_TICK_PER_SEC;
+    char *end = "";
+    
+    if (argc > 1 && strcmp(argv[1], "off") == 0) {
+        ticks = 0;
+    } else if (argc > 1) {
+        ticks = strtol(argv[1], &end, 10);
+    }
+    
+    // the whole argument has to be a number
+    if (ticks < 0 || *end != '\0' || (argc > 1 && end == argv[1])) {
+        kprintf("vmstat: bad interval '%s'\n", argv[1]);
+        return;
+    }
+    
+    swap_setSampleInterval(ticks);
+}
+
+static void monitor_run(char *line)
+{
+    char *argv[MONITOR_MAXARGS];
+    int argc = 0, i;
+    
+    // split the line by spaces
+    while (1) {
+        while (*line == ' ' || *line == '\t') {
+            *line++ = '\0';
+        }
+        
+        if (*line == '\0' || argc == MONITOR_MAXARGS) break;
+        
+        argv[argc++] = line;
+        
+        while (*line && *line != ' ' && *line != '\t') {
+            line++;
+        }
+    }
+    
+    if (!argc) return;
+    
+    for (i = 0; i < C0RE_ARRLEN(cmds); i++) {
+        if (strcmp(cmds[i].name, argv[0]) == 0) {
+            cmds[i].func(argc, argv);
+            return;
+        }
+    }
+    
+    kprintf("unknown command '%s', try 'help'\n", argv[0]);
+}
+
+// monitor_putc - called from the keyboard interrupt, a line is only
+//              - handed over to monitor_poll here
+void monitor_putc(int c)
+{
+    if (c == '\r' || c == '\n') {
+        kputc('\n');
+        
+        buf[buflen] = '\0';
+        buflen = 0;
+        
+        if (linePending) {
+            kprintf("monitor: busy, '%s' dropped\n", buf);
+            return;
+        }
+        
+        strcpy(line, buf);
+        linePending = 1;
+    } else if (c == '\b') {
+        if (buflen) {
+            buflen--;
+            kputc(c);
+        }
+    } else if (buflen < MONITOR_BUFSIZE - 1) {
+        buf[buflen++] = c;
+        kputc(c);
+    }
+}
+
+// monitor_poll - run the line entered last, called from the idle loop
+//              - so that commands never run inside the interrupt
+void monitor_poll()
+{
+    if (!linePending) {
+        return;
+    }
+    
+    monitor_run(line);
+    linePending = 0;
+}
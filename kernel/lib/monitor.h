@@ -0,0 +1,13 @@
+#ifndef _KERNEL_LIB_MONITOR_H_
+#define _KERNEL_LIB_MONITOR_H_
+
+/* a tiny line-based debug console fed by the keyboard interrupt */
+
+#include "pub/com.h"
+
+// feed one input character(echoed back), a line is queued on enter
+void monitor_putc(int c);
+// run the queued line if there is one
+void monitor_poll();
+
+#endif
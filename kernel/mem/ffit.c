@@ -176,9 +176,9 @@ static void check_basic()
     assert(p0 != p1 && p0 != p2 && p1 != p2);
     assert(page_getRef(p0) == 0 && page_getRef(p1) == 0 && page_getRef(p2) == 0);
 
-    assert(page2pa(p0) < c0re_npage * PAGE_SIZE);
-    assert(page2pa(p1) < c0re_npage * PAGE_SIZE);
-    assert(page2pa(p2) < c0re_npage * PAGE_SIZE);
+    assert(page2ppn(p0) < c0re_npage_low);
+    assert(page2ppn(p1) < c0re_npage_low);
+    assert(page2ppn(p2) < c0re_npage_low);
     
     page_t *freed = _FREED;
     _FREED = NULL;
@@ -232,7 +232,7 @@ static void ffit_check()
         prev = cur;
     }
 
-    assert(total == nfpage());
+    assert(total == _NFREE);
 
     check_basic();
 }
@@ -0,0 +1,435 @@
+#include "pub/com.h"
+#include "pub/x86.h"
+#include "pub/error.h"
+#include "pub/string.h"
+
+#include "lib/sync.h"
+#include "lib/debug.h"
+
+#include "mem/ksm.h"
+#include "mem/pmm.h"
+#include "mem/vmm.h"
+#include "mem/swap.h"
+#include "mem/swapcache.h"
+
+/**
+ * the scanner walks all present pages of all vma sets, a few pages at a time.
+ * each page is hashed and looked up in a table of pages seen in this pass,
+ * if a page with the same content is found(confirmed by memcmp), the page is
+ * dropped and its pte points to the other frame instead. merged frames are
+ * write-protected and flagged shared, a write to them goes to ksm_breakShare.
+ *
+ * the table is rebuilt on every pass, so it never holds pages for long.
+ **/
+
+#define KSM_TABLE_SIZE      2048 // must be a power of 2
+
+typedef struct {
+    uint32_t hash;
+    page_t *page;           // NULL if the slot is empty
+    vma_set_t *set;         // where the page was seen(only used if it's not shared yet)
+    uintptr_t addr;
+} ksm_entry_t;
+
+static ksm_entry_t ksm_table[KSM_TABLE_SIZE];
+
+static bool ksm_enabled = true;
+
+// scan position
+static struct {
+    vma_set_t *set;         // NULL if a new pass should start
+    uintptr_t addr;         // next address to scan in set
+} cursor;
+
+static struct {
+    size_t npass;           // full passes finished
+    size_t nscan;           // pages scanned
+    size_t nmerge;          // pages merged into another frame
+    size_t nbreak;          // shares broken by writes
+    uint64_t cycles;        // tsc cycles spent scanning
+} ksm_stat;
+
+static void check_ksm();
+
+void ksm_init()
+{
+    check_ksm();
+}
+
+void ksm_setEnabled(bool enabled)
+{
+    ksm_enabled = enabled;
+}
+
+static uint32_t ksm_hash(page_t *page)
+{
+    uint32_t *kva = kmap(page), *word = kva, *end = word + PAGE_SIZE / sizeof(uint32_t);
+    uint32_t hash = 0x811c9dc5;
+    
+    for (; word != end; word++) {
+        hash = (hash ^ *word) * 0x01000193;
+    }
+    
+    kunmap(kva);
+    
+    return hash;
+}
+
+static bool ksm_isSame(page_t *a, page_t *b)
+{
+    void *kva_a = kmap(a), *kva_b = kmap(b);
+    bool same = memcmp(kva_a, kva_b, PAGE_SIZE) == 0;
+    
+    kunmap(kva_b);
+    kunmap(kva_a);
+    
+    return same;
+}
+
+static void ksm_resetTable()
+{
+    memset(ksm_table, 0, sizeof(ksm_table));
+}
+
+// ksm_forgetSet - drop everything that refers to set(called before set is freed)
+void ksm_forgetSet(vma_set_t *set)
+{
+    int i;
+    
+    for (i = 0; i < KSM_TABLE_SIZE; i++) {
+        if (ksm_table[i].page && ksm_table[i].set == set) {
+            // leave the slot occupied so that probing still works
+            ksm_table[i].set = NULL;
+        }
+    }
+    
+    if (cursor.set == set) {
+        cursor.set = vma_set_next(set);
+        cursor.addr = 0;
+        
+        if (!cursor.set) {
+            ksm_stat.npass++;
+        }
+    }
+}
+
+// find the next present page of cursor.set, and move the cursor after it
+static pte_t *ksm_nextPage(uintptr_t *paddr)
+{
+    vma_set_t *set = cursor.set;
+    dllist_t *list = &(set->mset), *cur = list;
+    
+    if (!set->pgdir) {
+        return NULL;
+    }
+    
+    while ((cur = dllist_next(cur)) != list) {
+        vma_t *vma = dll2vma(cur, link);
+        uintptr_t addr = ROUNDDOWN(vma->start, PAGE_SIZE);
+        
+        if (addr < cursor.addr) {
+            addr = cursor.addr;
+        }
+        
+        for (; addr < vma->end; addr += PAGE_SIZE) {
+            pte_t *ptep = get_pte(set->pgdir, addr, false);
+            
+            if (!ptep) {
+                // no page table, skip all of it
+                addr = ROUNDDOWN(addr, PT_SIZE) + PT_SIZE - PAGE_SIZE;
+                continue;
+            }
+            
+            if (*ptep & PTE_FLAG_P) {
+                cursor.addr = addr + PAGE_SIZE;
+                *paddr = addr;
+                return ptep;
+            }
+        }
+    }
+    
+    return NULL;
+}
+
+// make sure the entry still refers to a page worth merging into
+static bool ksm_isValid(ksm_entry_t *ent)
+{
+    if (page_isShared(ent->page)) {
+        return page_getRef(ent->page) > 0;
+    }
+    
+    if (!ent->set) {
+        return false;
+    }
+    
+    pte_t *ptep = get_pte(ent->set->pgdir, ent->addr, false);
+    
+    return ptep && (*ptep & PTE_FLAG_P) &&
+           pte2page(*ptep) == ent->page && page_getRef(ent->page) == 1;
+}
+
+// map page(at addr of set) to the frame of ent if they have the same content
+static bool ksm_tryMerge(ksm_entry_t *ent, vma_set_t *set, uintptr_t addr,
+                         pte_t *ptep, page_t *page)
+{
+    page_t *kpage = ent->page;
+    
+    if (!ksm_isValid(ent) || !ksm_isSame(kpage, page)) {
+        return false;
+    }
+    
+    if (!page_isShared(kpage)) {
+        // first merge, write-protect the frame where it was seen
+        pte_t *kptep = get_pte(ent->set->pgdir, ent->addr, false);
+        
+        swap_setUnswappable(ent->set, ent->addr);
+        
+        // a cached page backs only one pte
+        if (page_isCached(kpage)) {
+            swap_cacheDrop(kpage);
+        }
+        
+        *kptep &= ~PTE_FLAG_W;
+        tlb_invalidate(ent->set->pgdir, ent->addr);
+        
+        page_setShared(kpage);
+        ent->set = NULL;
+    }
+    
+    swap_setUnswappable(set, addr);
+    
+    page_incRef(kpage);
+    *ptep = page2pa(kpage) | (*ptep & PTE_FLAG_U) | PTE_FLAG_P;
+    tlb_invalidate(set->pgdir, addr);
+    
+    if (page_decRef(page) == 0) {
+        pfree(page);
+    }
+    
+    ksm_stat.nmerge++;
+    
+    return true;
+}
+
+static void ksm_scanPage(vma_set_t *set, uintptr_t addr, pte_t *ptep)
+{
+    page_t *page = pte2page(*ptep);
+    
+    // only private pages or frames already merged
+    if (page_isReserved(page) ||
+        (!page_isShared(page) && page_getRef(page) != 1)) {
+        return;
+    }
+    
+    uint32_t hash = ksm_hash(page);
+    uint32_t i, idx = hash & (KSM_TABLE_SIZE - 1);
+    
+    for (i = 0; i < KSM_TABLE_SIZE; i++, idx = (idx + 1) & (KSM_TABLE_SIZE - 1)) {
+        ksm_entry_t *ent = &ksm_table[idx];
+        
+        if (!ent->page) {
+            // not seen yet
+            ent->hash = hash;
+            ent->page = page;
+            ent->set = page_isShared(page) ? NULL : set;
+            ent->addr = addr;
+            return;
+        }
+        
+        if (ent->page == page) {
+            return;
+        }
+        
+        if (ent->hash == hash && !page_isShared(page) &&
+            ksm_tryMerge(ent, set, addr, ptep, page)) {
+            return;
+        }
+    }
+    
+    // table full, wait for the next pass
+}
+
+// ksm_scan - scan at most n pages, stop early at the end of a pass
+// return value: number of pages scanned
+size_t ksm_scan(size_t n)
+{
+    uint64_t begin = rdtsc();
+    size_t nscan = 0;
+    
+    uintptr_t addr;
+    pte_t *ptep;
+    
+    if (!ksm_enabled) {
+        return 0;
+    }
+    
+    while (nscan < n) {
+        if (!cursor.set) {
+            // start a new pass
+            if (!(cursor.set = vma_set_next(NULL))) break;
+            
+            cursor.addr = 0;
+            ksm_resetTable();
+        }
+        
+        bool found;
+        
+        no_intr_block({
+            if ((found = (ptep = ksm_nextPage(&addr)) != NULL)) {
+                ksm_scanPage(cursor.set, addr, ptep);
+            }
+        });
+        
+        if (found) {
+            nscan++;
+            continue;
+        }
+        
+        // move to the next set
+        cursor.set = vma_set_next(cursor.set);
+        cursor.addr = 0;
+        
+        if (!cursor.set) {
+            ksm_stat.npass++;
+            break;
+        }
+    }
+    
+    ksm_stat.nscan += nscan;
+    ksm_stat.cycles += rdtsc() - begin;
+    
+    return nscan;
+}
+
+// ksm_breakShare - handle a write to a shared page at addr, ptep is its pte
+//                - the page is copied unless this is the last reference
+// return value: 0 on success(the page now mapped is stored in result),
+//               -E_NO_MEM if the copy can't be allocated
+int ksm_breakShare(vma_set_t *set, uintptr_t addr, pte_t *ptep,
+                   uint32_t perm, page_t **result)
+{
+    page_t *page = pte2page(*ptep), *npage;
+    
+    if (!page_isShared(page) || page_getRef(page) == 1) {
+        // the last one, just take it over
+        page_resetShared(page);
+        npage = page;
+    } else {
+        if (!(npage = palloc_high())) {
+            return -E_NO_MEM;
+        }
+        
+        void *src = kmap(page), *dst = kmap(npage);
+        memcpy(dst, src, PAGE_SIZE);
+        kunmap(dst);
+        kunmap(src);
+        
+        page_decRef(page);
+        page_incRef(npage);
+    }
+    
+    *ptep = page2pa(npage) | PTE_FLAG_P | perm;
+    tlb_invalidate(set->pgdir, addr);
+    
+    ksm_stat.nbreak++;
+    *result = npage;
+    
+    return 0;
+}
+
+void ksm_dumpStat()
+{
+    size_t nshared = 0, nsharing = 0, i;
+    uint64_t avg = ksm_stat.cycles;
+    
+    for (i = 0; i < c0re_npage; i++) {
+        if (page_isShared(c0re_pages + i)) {
+            nshared++;
+            nsharing += page_getRef(c0re_pages + i) - 1;
+        }
+    }
+    
+    if (ksm_stat.nscan) {
+        do_div(avg, ksm_stat.nscan);
+    }
+    
+    kprintf("ksm: %s\n", ksm_enabled ? "enabled" : "disabled");
+    kprintf(DBG_TAB "shared frames %u, pages saved %u(%u KB)\n",
+            nshared, nsharing, nsharing * (PAGE_SIZE / 1024));
+    kprintf(DBG_TAB "passes %u, scanned %u, merged %u, broken %u\n",
+            ksm_stat.npass, ksm_stat.nscan, ksm_stat.nmerge, ksm_stat.nbreak);
+    kprintf(DBG_TAB "cycles %llu, %llu per page\n", ksm_stat.cycles, avg);
+}
+
+static void check_ksm()
+{
+    extern vma_set_t *c0re_check_vma_set;
+    
+    size_t nfree = nfpage();
+    
+    vma_set_t *set = c0re_check_vma_set = vma_set_new();
+    pde_t *pgdir = set->pgdir = c0re_pgdir;
+    
+    assert(set);
+    assert(pgdir[0] == 0);
+    assert(vma_set_next(NULL) == set && vma_set_next(set) == NULL);
+    
+    vma_set_insert(set, vma_new(0, 4 * PAGE_SIZE, VMA_FLAG_READ | VMA_FLAG_WRITE));
+    assert(vma_populate(set, 0, 4 * PAGE_SIZE, true) == 4);
+    
+    // 0 == 2, 1 == 3
+    memset((void *)(0 * PAGE_SIZE), 0xab, PAGE_SIZE);
+    memset((void *)(1 * PAGE_SIZE), 0xcd, PAGE_SIZE);
+    memset((void *)(2 * PAGE_SIZE), 0xab, PAGE_SIZE);
+    memset((void *)(3 * PAGE_SIZE), 0xcd, PAGE_SIZE);
+    
+    size_t base = nfpage();
+    
+    // one full pass
+    cursor.set = NULL;
+    assert(ksm_scan(KSM_SCAN_NPAGE) == 4);
+    assert(nfpage() == base + 2);
+    
+    page_t *p0 = get_page(pgdir, 0 * PAGE_SIZE, NULL);
+    page_t *p1 = get_page(pgdir, 1 * PAGE_SIZE, NULL);
+    
+    assert(p0 != p1);
+    assert(get_page(pgdir, 2 * PAGE_SIZE, NULL) == p0);
+    assert(get_page(pgdir, 3 * PAGE_SIZE, NULL) == p1);
+    assert(page_isShared(p0) && page_getRef(p0) == 2);
+    
+    size_t init = vmm_getPageFaultCount();
+    
+    // copy on write
+    *(unsigned char *)(2 * PAGE_SIZE) = 0x12;
+    assert(vmm_getPageFaultCount() - init == 1);
+    assert(nfpage() == base + 1);
+    assert(get_page(pgdir, 2 * PAGE_SIZE, NULL) != p0);
+    assert(*(unsigned char *)(0 * PAGE_SIZE) == 0xab);
+    assert(*(unsigned char *)(2 * PAGE_SIZE + 1) == 0xab);
+    
+    // last user takes the frame back
+    *(unsigned char *)(0 * PAGE_SIZE) = 0x34;
+    assert(vmm_getPageFaultCount() - init == 2);
+    assert(nfpage() == base + 1);
+    assert(!page_isShared(p0) && page_getRef(p0) == 1);
+    
+    int i;
+    
+    for (i = 0; i < 4; i++) {
+        vma_set_unmap(set, i * PAGE_SIZE);
+    }
+    
+    pfree(pde2page(pgdir[0]));
+    pgdir[0] = 0;
+    
+    set->pgdir = NULL;
+    vma_set_free(set);
+    
+    c0re_check_vma_set = NULL;
+    cursor.set = NULL;
+    
+    assert(nfree == nfpage());
+    
+    trace("check success: ksm");
+}
@@ -0,0 +1,24 @@
+#ifndef _KERNEL_MEM_KSM_H_
+#define _KERNEL_MEM_KSM_H_
+
+/* same-page merging: pages with identical contents share one read-only frame */
+
+#include "pub/com.h"
+
+#include "mem/mmu.h"
+#include "mem/vmm.h"
+
+// pages scanned each time the kernel goes idle
+#define KSM_SCAN_NPAGE          64
+
+void ksm_init();
+
+size_t ksm_scan(size_t n);
+void ksm_forgetSet(vma_set_t *set);
+int ksm_breakShare(vma_set_t *set, uintptr_t addr, pte_t *ptep,
+                   uint32_t perm, page_t **result);
+
+void ksm_setEnabled(bool enabled);
+void ksm_dumpStat();
+
+#endif
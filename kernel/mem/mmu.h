@@ -228,11 +228,13 @@
  *                            |                                 |
  *                            |         Empty Memory (*)        |
  *                            |                                 |
- *                            +---------------------------------+ 0xFB000000
- *                            |   Cur. Page Table (Kern, RW)    | RW/-- PTSIZE
+ *                            +---------------------------------+ 0xFB000000(0xFB400000 with PAE)
+ *                            |   Cur. Page Table (Kern, RW)    | RW/-- VPT_SIZE
  *     VPT -----------------> +---------------------------------+ 0xFAC00000
  *                            |        Invalid Memory (*)       | --/--
- *     KERNTOP -------------> +---------------------------------+ 0xF8000000
+ *                            +---------------------------------+ 0xF8400000
+ *                            |    Kmap Slots (Kern, RW)        | RW/-- PTSIZE
+ *     KERNTOP, KMAP -------> +---------------------------------+ 0xF8000000
  *                            |                                 |
  *                            |    Remapped Physical Memory     | RW/-- KMEMSIZE
  *                            |                                 |
@@ -252,6 +254,24 @@
 #define KERNEL_MEMSIZE         0x38000000                           // the maximum amount of physical memory
 #define KERNEL_TOP             (KERNEL_BASE + KERNEL_MEMSIZE)
 
+/**
+ * physical memory above KERNEL_MEMSIZE(highmem) is not mapped by the kernel,
+ * a highmem page is mapped temporarily into one of the kmap slots when the
+ * kernel needs to touch it.
+ *
+ * with C0RE_PAE, physical addresses are 36 bits or more wide, so highmem can
+ * reach beyond 4G. it's limited to 16G here, since every page has a page_t in
+ * lowmem.
+ **/
+#ifdef C0RE_PAE
+    #define KERNEL_HIGHMEM_TOP 0x400000000ULL                       // highmem ends here(exclusive)
+#else
+    #define KERNEL_HIGHMEM_TOP 0xFFFFF000
+#endif
+
+#define KERNEL_KMAP            KERNEL_TOP
+#define KERNEL_KMAP_NSLOT      PT_NENTRY                            // one page table
+
 #define KERNEL_PGSIZE          4096                                 // page size
 #define KERNEL_STACKPAGE       2                                    // # of pages in kernel stack
 #define KERNEL_STACKSIZE       (KERNEL_STACKPAGE * KERNEL_PGSIZE)   // sizeof kernel stack
@@ -261,6 +281,10 @@
  * a pointer to the page directory itself, thereby turning the PD into a page
  * table, which maps all the PTEs (Page Table Entry) containing the page mappings
  * for the entire virtual address space into that 4 Meg region starting at VPT.
+ *
+ * with C0RE_PAE, the four page directories are allocated contiguously and
+ * treated as one 2048-entry directory, and four entries starting at PDX[VPT]
+ * point to them, so the region is 8 Meg.
  **/
 #define KERNEL_VPT                 0xFAC00000
 
@@ -272,8 +296,17 @@
     #include "pub/atomic.h"
     #include "pub/dllist.h"
 
-    typedef uintptr_t pte_t;
-    typedef uintptr_t pde_t;
+    #ifdef C0RE_PAE
+        typedef uint64_t pte_t;
+        typedef uint64_t pde_t;
+        typedef uint64_t pdpte_t;
+        typedef uint64_t paddr_t;       // physical address
+    #else
+        typedef uintptr_t pte_t;
+        typedef uintptr_t pde_t;
+        typedef uintptr_t paddr_t;
+    #endif
+
     typedef size_t page_number_t;
 
     // some constants for bios interrupt 15h AX = 0xE820
@@ -306,6 +339,10 @@
         
         dllist_t pra_link;              // used for pra (page replace algorithm)
         uintptr_t pra_vaddr;            // used for pra (page replace algorithm)
+        
+        // used for the swap cache
+        pte_t swap_entry;               // swap slot holding a copy of the page
+        struct page_t_tag *swap_next;   // hash chain
     } page_t;
     
     // convert dllist node to page
@@ -315,6 +352,12 @@
     /* flags describing the status of a page frame */
     #define PAGE_FLAG_RESV              0 // the page is reserved for kernel and cannot be allocated
     #define PAGE_FLAG_FREE              1 // the page is freed
+    #define PAGE_FLAG_SHARED            2 // the page is merged by ksm and mapped read-only
+    #define PAGE_FLAG_SWAP              3 // the page is managed by the swap manager
+    #define PAGE_FLAG_CACHED            4 // the page is in the swap cache
+    #define PAGE_FLAG_PARKED            5 // the page is in the swap cache and not mapped
+    #define PAGE_FLAG_READAHEAD         6 // the page is read ahead and not faulted on yet
+    #define PAGE_FLAG_ACTIVE            7 // the page is in the frequency list of the swap manager
 
     #define page_setReserved(p)         btsl(PAGE_FLAG_RESV, &(p)->flags)
     #define page_resetReserved(p)       btrl(PAGE_FLAG_RESV, &(p)->flags)
@@ -324,6 +367,30 @@
     #define page_resetFree(p)           btrl(PAGE_FLAG_FREE, &(p)->flags)
     #define page_isFree(p)              btl(PAGE_FLAG_FREE, &(p)->flags)
 
+    #define page_setShared(p)           btsl(PAGE_FLAG_SHARED, &(p)->flags)
+    #define page_resetShared(p)         btrl(PAGE_FLAG_SHARED, &(p)->flags)
+    #define page_isShared(p)            btl(PAGE_FLAG_SHARED, &(p)->flags)
+
+    #define page_setSwap(p)             btsl(PAGE_FLAG_SWAP, &(p)->flags)
+    #define page_resetSwap(p)           btrl(PAGE_FLAG_SWAP, &(p)->flags)
+    #define page_isSwap(p)              btl(PAGE_FLAG_SWAP, &(p)->flags)
+
+    #define page_setCached(p)           btsl(PAGE_FLAG_CACHED, &(p)->flags)
+    #define page_resetCached(p)         btrl(PAGE_FLAG_CACHED, &(p)->flags)
+    #define page_isCached(p)            btl(PAGE_FLAG_CACHED, &(p)->flags)
+
+    #define page_setParked(p)           btsl(PAGE_FLAG_PARKED, &(p)->flags)
+    #define page_resetParked(p)         btrl(PAGE_FLAG_PARKED, &(p)->flags)
+    #define page_isParked(p)            btl(PAGE_FLAG_PARKED, &(p)->flags)
+    
+    #define page_setReadahead(p)        btsl(PAGE_FLAG_READAHEAD, &(p)->flags)
+    #define page_resetReadahead(p)      btrl(PAGE_FLAG_READAHEAD, &(p)->flags)
+    #define page_isReadahead(p)         btl(PAGE_FLAG_READAHEAD, &(p)->flags)
+    
+    #define page_setActive(p)           btsl(PAGE_FLAG_ACTIVE, &(p)->flags)
+    #define page_resetActive(p)         btrl(PAGE_FLAG_ACTIVE, &(p)->flags)
+    #define page_isActive(p)            btl(PAGE_FLAG_ACTIVE, &(p)->flags)
+
     #define page_clearFlags(p)          ((p)->flags = 0)
 
     #define page_clearRef(p)            ((p)->ref = 0)
@@ -340,15 +407,57 @@
     //  \--- PDX(la) --/ \--- PTX(la) --/ \---- POFF(la) ----/
     //  \----------- PPN(la) -----------/
     //
+    // with C0RE_PAE, the hardware walks a 4-entry page directory pointer
+    // table(PDPT, indexed by bits 31-30) to one of four page directories
+    // of 512 entries, and page tables have 512 entries, so
+    //
+    // +---2---+------9-------+-------9--------+---------12---------+
+    // | PDPT  |    Page      |   Page Table   | Offset within Page |
+    // | Index | Dir. Index   |     Index      |                    |
+    // +-------+--------------+----------------+--------------------+
+    //  \---------- PDX(la) -/ \--- PTX(la) --/ \---- POFF(la) ----/
+    //
+    // the four page directories are contiguous, so PDX still indexes a single
+    // array and get_pte & friends don't need to know about the PDPT.
+    
+    /* page directory and page table constants */
+    #ifdef C0RE_PAE
+        #define PD_NENTRY   2048                    // page directory entries(in all four page directories)
+        #define PT_NENTRY   512                     // page table entries per page table
+        #define PT_SHIFT    21                      // log2(PT_SIZE)
+        #define PDPT_NENTRY 4                       // entries in the page directory pointer table
+        
+        #define PTE_ADDR_MASK 0x000ffffffffff000ULL // bits 12 - 51
+    #else
+        #define PD_NENTRY   1024                    // page directory entries per page directory
+        #define PT_NENTRY   1024                    // page table entries per page table
+        #define PT_SHIFT    22                      // log2(PT_SIZE)
+        
+        #define PTE_ADDR_MASK 0xfffff000
+    #endif
+    
+    #define PAGE_SIZE       4096                    // bytes mapped by a page
+    #define PAGE_SHIFT      12                      // log2(PAGE_SIZE)
+    #define PT_SIZE         (PAGE_SIZE * PT_NENTRY) // bytes mapped by a page directory entry
+    
+    #define PT_INDEX_SHIFT  12                      // offset of PT_INDEX_SHIFT in a linear address
+    #define PD_INDEX_SHIFT  PT_SHIFT                // offset of PD_INDEX_SHIFT in a linear address
+    
+    // # of pages of a page directory
+    #define PGDIR_NPAGE     (PD_NENTRY * sizeof(pde_t) / PAGE_SIZE)
+    
+    // size of the virtual page table at KERNEL_VPT, and # of pde's mapping it
+    #define VPT_SIZE        (PD_NENTRY * PAGE_SIZE)
+    #define VPT_NPDE        PGDIR_NPAGE
     
     // page directory index
-    #define PD_INDEX(la) ((((uintptr_t)(la)) >> PD_INDEX_SHIFT) & 0x3ff)
+    #define PD_INDEX(la) ((((uintptr_t)(la)) >> PD_INDEX_SHIFT) & (PD_NENTRY - 1))
     
     // page table index
-    #define PT_INDEX(la) ((((uintptr_t)(la)) >> PT_INDEX_SHIFT) & 0x3ff)
+    #define PT_INDEX(la) ((((uintptr_t)(la)) >> PT_INDEX_SHIFT) & (PT_NENTRY - 1))
     
     // page number field of address
-    #define PAGE_NUMBER(la) (((uintptr_t)(la)) >> PT_INDEX_SHIFT)
+    #define PAGE_NUMBER(la) ((uintptr_t)((la) >> PT_INDEX_SHIFT))
     
     // offset in page
     #define PAGE_OFS(la) (((uintptr_t)(la)) & 0xfff)
@@ -357,20 +466,11 @@
     #define PAGE_ADDR(d, t, o) (((uintptr_t)(d) << PD_INDEX_SHIFT | (uintptr_t)(t) << PT_INDEX_SHIFT | (uintptr_t)(o)))
     
     // address in page table or page directory entry
-    #define PTE_ADDR(pte)   ((uintptr_t)(pte) & ~0xfff)
+    #define PTE_ADDR(pte)   ((paddr_t)(pte) & PTE_ADDR_MASK)
     #define PDE_ADDR(pde)   PTE_ADDR(pde)
     
-    /* page directory and page table constants */
-    #define PD_NENTRY       1024                    // page directory entries per page directory
-    #define PT_NENTRY       1024                    // page table entries per page table
-    
-    #define PAGE_SIZE       4096                    // bytes mapped by a page
-    #define PAGE_SHIFT      12                      // log2(PAGE_SIZE)
-    #define PT_SIZE         (PAGE_SIZE * PT_NENTRY) // bytes mapped by a page directory entry
-    #define PT_SHIFT        22                      // log2(PT_SIZE)
-    
-    #define PT_INDEX_SHIFT  12                      // offset of PT_INDEX_SHIFT in a linear address
-    #define PD_INDEX_SHIFT  22                      // offset of PD_INDEX_SHIFT in a linear address
+    // address of a large page(PTE_FLAG_PS set in the pde)
+    #define PDE_ADDR_LARGE(pde) (PTE_ADDR(pde) & ~((paddr_t)PT_SIZE - 1))
     
     /* page table/directory entry flags */
     #define PTE_FLAG_P      0x001                   // present
@@ -380,7 +480,7 @@
     #define PTE_FLAG_PCD    0x010                   // cache-Disable
     #define PTE_FLAG_A      0x020                   // accessed
     #define PTE_FLAG_D      0x040                   // dirty
-    #define PTE_FLAG_PS     0x080                   // page Size
+    #define PTE_FLAG_PS     0x080                   // page Size(in a pde, 4M or 2M with PAE)
     #define PTE_FLAG_MBZ    0x180                   // bits must be zero
     #define PTE_FLAG_AVAIL  0xe00                   // available for software use
                                                     // the PTE_AVAIL bits aren't used by the kernel or interpreted by the
@@ -403,6 +503,7 @@
     
     #define CR4_PCE         0x00000100              // performance counter enable
     #define CR4_MCE         0x00000040              // machine check enable
+    #define CR4_PAE         0x00000020              // physical address extension
     #define CR4_PSE         0x00000010              // page size extensions
     #define CR4_DE          0x00000008              // debugging extensions
     #define CR4_TSD         0x00000004              // time stamp disable
@@ -10,6 +10,7 @@
 #include "mem/pmm.h"
 #include "mem/vmm.h"
 #include "mem/swap.h"
+#include "mem/swapcache.h"
 #include "mem/ffit.h"
 
 /* *
@@ -36,6 +37,10 @@ static taskstate_t ts = {0};
 
 page_t *c0re_pages;
 size_t c0re_npage;
+size_t c0re_npage_low;
+
+// free highmem pages, a stack of single pages linked by next
+free_area_t high_area;
 
 const page_allocator_t *page_alloc;
 
@@ -124,6 +129,91 @@ static void addMem(page_t *base, size_t n)
     page_alloc->addMem(base, n);
 }
 
+// pages swapped out together while freeing a range, see palloc_reclaim
+#define PALLOC_RECLAIM_BATCH 16
+
+// a page that can be freed for a range: parked in the swap cache, or
+// mapped by a single swappable pte
+C0RE_INLINE
+bool palloc_isMovable(page_t *page)
+{
+    return page->nfree == 1 && !page_isReserved(page) && !page_isShared(page) &&
+           (page_isParked(page) || (page_isSwap(page) && page_getRef(page) == 1));
+}
+
+// palloc_reclaim - free n contiguous pages in [base, base + npage) of lowmem
+//                - swapping out victims here and there seldom frees a run,
+//                - so among the ranges of free, parked and swappable pages
+//                - the one with the fewest pages to swap out is chosen, and
+//                - exactly its pages are evicted and freed
+// return value: whether such a range was found
+bool palloc_reclaim(size_t n, page_t *base, size_t npage)
+{
+    page_t *p, *end = base + npage, *best = NULL;
+    size_t run = 0, cost = 0, best_cost = 0, len, i;
+    
+    // cost is the # of swappable pages in the last run pages
+    for (p = base; p < end && (!best || best_cost); p += len) {
+        len = page_isFree(p) ? p->nfree : 1;
+        
+        if (!page_isFree(p) && !palloc_isMovable(p)) {
+            // kernel data, reserved or shared
+            len = p->nfree ? p->nfree : 1;
+            run = cost = 0;
+            continue;
+        }
+        
+        for (i = 0; i < len && p + i < end; i++) {
+            cost += page_isSwap(p + i);
+            
+            if (++run > n) {
+                cost -= page_isSwap(p + i - n);
+                run = n;
+            }
+            
+            if (run == n && (!best || cost < best_cost)) {
+                best = p + i + 1 - n;
+                best_cost = cost;
+            }
+        }
+    }
+    
+    if (!best) {
+        return 0;
+    }
+    
+    trace("swap: free %d pages from %p, %d to swap out", n, best, best_cost);
+    
+    page_t *batch[PALLOC_RECLAIM_BATCH];
+    vma_set_t *set = NULL, *owner;
+    size_t nbatch = 0;
+    
+    for (p = best; p < best + n; p++) {
+        if (!page_isSwap(p) || !(owner = swap_pageOwner(p))) {
+            continue;
+        }
+        
+        if (nbatch && (owner != set || nbatch == PALLOC_RECLAIM_BATCH)) {
+            swap_outPages(set, batch, nbatch);
+            nbatch = 0;
+        }
+        
+        set = owner;
+        batch[nbatch++] = p;
+    }
+    
+    if (nbatch) {
+        swap_outPages(set, batch, nbatch);
+    }
+    
+    // the pages swapped out are parked, nothing else holds them
+    for (p = best; p < best + n; p++) {
+        swap_cacheRelease(p);
+    }
+    
+    return 1;
+}
+
 page_t *palloc(size_t n)
 {
     page_t *ret;
@@ -133,15 +223,27 @@ page_t *palloc(size_t n)
         no_intr_block(ret = page_alloc->alloc(n));
     
         // successful allocation OR
-        // too big block OR
         // no swap space
-        if (ret || n > 1 || !swap_hasInit()) break;
-    
-        extern vma_set_t *c0re_check_vma_set;
-        trace("swap: out of memory, try to swap out %d pages", n);
-        swap_out(c0re_check_vma_set, n, 0);
+        if (ret || !swap_hasInit()) break;
     
         retry++;
+        
+        if (n > 1) {
+            // a run is needed, not just any n pages
+            if (!palloc_reclaim(n, c0re_pages, c0re_npage_low)) break;
+            continue;
+        }
+        
+        // parked pages in the swap cache can go without any i/o
+        if (swap_cacheShrink(n)) continue;
+        
+        // sets over their rss limit go first
+        vma_set_t *set = swap_pickSet();
+        if (!set) break;
+        
+        trace("swap: out of memory, try to swap out %d pages", n);
+        swap_out(set, n, 0);
+        swap_cacheShrink(n);
     }
     
     if (retry == SWAP_MAX_RETRY_TIME) {
@@ -151,15 +253,129 @@ page_t *palloc(size_t n)
     return ret;
 }
 
+static page_t *high_alloc()
+{
+    page_t *page = high_area.freed;
+    
+    if (page) {
+        high_area.freed = page->next;
+        high_area.nfree--;
+        
+        page_resetFree(page);
+        page->nfree = 1;
+    }
+    
+    return page;
+}
+
+static void high_free(page_t *page)
+{
+    assert(!page_isReserved(page) && !page_isFree(page));
+    
+    page_clearFlags(page);
+    page_clearRef(page);
+    page_setFree(page);
+    
+    page->next = high_area.freed;
+    high_area.freed = page;
+    high_area.nfree++;
+}
+
+C0RE_INLINE
+page_t *palloc_high_only()
+{
+    page_t *page;
+    no_intr_block(page = high_alloc());
+    return page;
+}
+
+// palloc_high - allocate a page for user mappings, highmem is preferred
+page_t *palloc_high()
+{
+    page_t *page = palloc_high_only();
+    return page ? page : palloc(1);
+}
+
+// palloc_try - allocate a page for user mappings only if one is free
+//            - nothing is reclaimed for it
+page_t *palloc_try()
+{
+    page_t *page = palloc_high_only();
+    
+    if (!page) {
+        no_intr_block(page = page_alloc->alloc(1));
+    }
+    
+    return page;
+}
+
+// palloc_low_try - allocate a lowmem page only if one is free
+//                - for kernel data made while reclaiming, nothing is reclaimed for it
+page_t *palloc_low_try()
+{
+    page_t *page;
+    no_intr_block(page = page_alloc->alloc(1));
+    return page;
+}
+
+// palloc_batch - allocate n single pages using as few allocator calls as possible
+//              - big blocks are split so that each page can be pfree'd on its own
+// return value: the number of pages stored in pages(less than n if out of memory)
+size_t palloc_batch(page_t **pages, size_t n)
+{
+    size_t got = 0, want = n, i;
+    page_t *block;
+    
+    // these are user pages, use highmem first
+    while (got < n && (block = palloc_high_only()) != NULL) {
+        pages[got++] = block;
+    }
+    
+    while (got < n) {
+        if (want > n - got) {
+            want = n - got;
+        }
+        
+        no_intr_block(block = page_alloc->alloc(want));
+        
+        if (!block) {
+            if (want > 1) {
+                // too fragmented, try a smaller block
+                want /= 2;
+                continue;
+            }
+            
+            // last chance, with swap
+            if (!(block = palloc(1))) break;
+        }
+        
+        for (i = 0; i < want; i++) {
+            block[i].nfree = 1; // split the block
+            pages[got++] = block + i;
+        }
+    }
+    
+    return got;
+}
+
 void pfree(page_t *base)
 {
-    no_intr_block(page_alloc->free(base));
+    if (page_isCached(base)) {
+        swap_cacheDrop(base);
+    }
+    
+    if (page_isHigh(base)) {
+        no_intr_block(high_free(base));
+    } else {
+        no_intr_block(page_alloc->free(base));
+    }
 }
 
+// free pages in both lowmem and highmem
 size_t nfpage()
 {
     size_t ret;
-    no_intr_block(ret = page_alloc->nfree());
+    no_intr_block(ret = page_alloc->nfree() + high_area.nfree);
     return ret;
 }
 
@@ -180,26 +396,32 @@ static void page_init()
               memmap->map[i].size, begin, end - 1, memmap->map[i].type);
               
         if (memmap->map[i].type == E820_ARM) {
-            if (maxpa < end && begin < KERNEL_MEMSIZE) {
+            if (maxpa < end && begin < KERNEL_HIGHMEM_TOP) {
                 maxpa = end;
             }
         }
     }
     
-    if (maxpa > KERNEL_MEMSIZE) {
-        maxpa = KERNEL_MEMSIZE;
+    if (maxpa > KERNEL_HIGHMEM_TOP) {
+        maxpa = KERNEL_HIGHMEM_TOP;
     }
 
     extern char bss_end[];
 
     c0re_pages = (page_t *)ROUNDUP((void *)bss_end, PAGE_SIZE);
     c0re_npage = maxpa / PAGE_SIZE;
+    c0re_npage_low = (maxpa > KERNEL_MEMSIZE ? KERNEL_MEMSIZE : maxpa) / PAGE_SIZE;
 
     for (i = 0; i < c0re_npage; i++) {
         page_setReserved(c0re_pages + i);
     }
 
     uintptr_t freemem = PADDR((uintptr_t)c0re_pages + sizeof(page_t) * c0re_npage);
+    
+    assert(freemem < KERNEL_MEMSIZE);
+    
+    high_area.freed = NULL;
+    high_area.nfree = 0;
 
     for (i = 0; i < memmap->nmap; i++) {
         uint64_t begin = memmap->map[i].addr, end = begin + memmap->map[i].size;
@@ -209,19 +431,41 @@ static void page_init()
                 begin = freemem;
             }
             
-            if (end > KERNEL_MEMSIZE) {
-                end = KERNEL_MEMSIZE;
+            if (end > maxpa) {
+                end = maxpa;
             }
             
-            if (begin < end) {
-                begin = ROUNDUP(begin, PAGE_SIZE);
-                end = ROUNDDOWN(end, PAGE_SIZE);
-                if (begin < end) {
-                    addMem(pa2page(begin), (end - begin) / PAGE_SIZE);
+            // ROUNDUP/ROUNDDOWN would truncate addresses above 4G
+            begin = (begin + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+            end &= ~(uint64_t)(PAGE_SIZE - 1);
+            
+            // the part in lowmem goes to the allocator
+            if (begin < KERNEL_MEMSIZE) {
+                uint64_t low_end = end > KERNEL_MEMSIZE ? KERNEL_MEMSIZE : end;
+                
+                if (begin < low_end) {
+                    addMem(pa2page(begin), (low_end - begin) / PAGE_SIZE);
                 }
+                
+                begin = KERNEL_MEMSIZE;
+            }
+            
+            // the rest is highmem
+            for (; begin < end; begin += PAGE_SIZE) {
+                page_t *page = pa2page(begin);
+                
+                page_clearFlags(page);
+                page_clearRef(page);
+                page->nfree = 0;
+                
+                high_free(page);
             }
         }
     }
+    
+    if (high_area.nfree) {
+        trace("highmem: %u pages", high_area.nfree);
+    }
 }
 
 // get_pte - get pte and return the kernel virtual address of this pte for la
@@ -238,6 +482,12 @@ pte_t *get_pte(pde_t *pgdir, uintptr_t la, bool create)
     
     pde_t *pdep = &pgdir[PD_INDEX(la)];
     
+    if (*pdep & PTE_FLAG_PS) {
+        // mapped by a large page, there is no page table
+        assert(!create);
+        return NULL;
+    }
+    
     if (!(*pdep & PTE_FLAG_P)) {
         // not present -> alloc page
         page_t *page;
@@ -249,7 +499,7 @@ pte_t *get_pte(pde_t *pgdir, uintptr_t la, bool create)
         page_clearRef(page);
         page_incRef(page);
         
-        uintptr_t pa = page2pa(page);
+        paddr_t pa = page2pa(page);
         memset(KADDR(pa), 0, PAGE_SIZE);
         
         *pdep = pa | PTE_FLAG_U | PTE_FLAG_W | PTE_FLAG_P;
@@ -269,12 +519,13 @@ pte_t *get_pte(pde_t *pgdir, uintptr_t la, bool create)
 //  pa:   physical address of this memory
 //  size: memory size
 //  perm: permission of this memory  
+//        with PTE_FLAG_PS, PT_SIZE aligned parts are mapped by large pages
 
 // this functin basically maps the range [la, la + size)
 // to a physical address range [pa, pa + size)
 // "segment" has no special meaning here
 static void
-map_segment(pde_t *pgdir, uintptr_t la, uintptr_t pa,
+map_segment(pde_t *pgdir, uintptr_t la, paddr_t pa,
             size_t size, uint32_t perm)
 {
     // same page offset
@@ -283,21 +534,49 @@ map_segment(pde_t *pgdir, uintptr_t la, uintptr_t pa,
     // align adresses to pages
     size_t n = ROUNDUP(size + PAGE_OFS(la), PAGE_SIZE) / PAGE_SIZE;
     la = ROUNDDOWN(la, PAGE_SIZE);
-    pa = ROUNDDOWN(pa, PAGE_SIZE);
+    pa -= PAGE_OFS(pa);
+    
+    bool large = perm & PTE_FLAG_PS;
+    perm &= ~PTE_FLAG_PS;
     
-    for (; n > 0; n--, la += PAGE_SIZE, pa += PAGE_SIZE) {
+    while (n > 0) {
+        if (large && n >= PT_NENTRY &&
+            la % PT_SIZE == 0 && (pa & (PT_SIZE - 1)) == 0) {
+            pde_t *pdep = &pgdir[PD_INDEX(la)];
+            assert(!(*pdep & PTE_FLAG_P));
+            
+            *pdep = pa | PTE_FLAG_PS | PTE_FLAG_P | perm;
+            
+            n -= PT_NENTRY;
+            la += PT_SIZE;
+            pa += PT_SIZE;
+            continue;
+        }
+        
         pte_t *pte = get_pte(pgdir, la, true);
         // the corresponding page table entry(which stores a physcial address
         // that the linear address maps to)
         assert(pte != NULL);
 
         *pte = pa | PTE_FLAG_P | perm;
+        
+        n--;
+        la += PAGE_SIZE;
+        pa += PAGE_SIZE;
     }
 }
 
-static void page_enable(uintptr_t pgdir_pa)
+static void page_enable(uintptr_t cr3)
 {
-    lcr3(pgdir_pa);
+    // large pages are used for the direct map
+    uint32_t cr4 = rcr4() | CR4_PSE;
+    
+#ifdef C0RE_PAE
+    cr4 |= CR4_PAE;
+#endif
+
+    lcr4(cr4);
+    lcr3(cr3);
 
     // turn on paging
     uint32_t cr0 = rcr0();
@@ -310,12 +589,19 @@ static void page_enable(uintptr_t pgdir_pa)
 
 // virtual address of boot-time page directory
 pde_t *c0re_pgdir;
-// physical address of boot-time page directory(stored in cr3)
-uintptr_t c0re_pgdir_pa;
+// physical address of boot-time page directory(stored in cr3 without PAE)
+paddr_t c0re_pgdir_pa;
+
+#ifdef C0RE_PAE
+// page directory pointer table of c0re_pgdir(stored in cr3)
+// it must be 32-byte aligned and below 4G, so it's kept in the kernel image
+static pdpte_t c0re_pdpt[PDPT_NENTRY] C0RE_ALIGNED(32);
+#endif
 
 //get_pgtable_items - In [left, right] range of PDT or PT, find a continuous linear addr space
 //                  - (left_store*X_SIZE~right_store*X_SIZE) for PDT or PT
-//                  - X_SIZE=PTSIZE=4M, if PDT; X_SIZE=PAGE_SIZE=4K, if PT
+//                  - X_SIZE=PT_SIZE=4M(2M with PAE), if PDT; X_SIZE=PAGE_SIZE=4K, if PT
+//                  - large pages and page tables are never in the same range
 // paramemters:
 //  left:        the low side of table's range
 //  right:       the high side of table's range
@@ -323,7 +609,7 @@ uintptr_t c0re_pgdir_pa;
 //  next_left:   the pointer of the high side of table's next range
 //  next_right:  the pointer of the low side of table's next range
 // return value: 0 - not a invalid item range, perm - a valid item range with perm permission
-static int get_pgtable_items(size_t left, size_t right, uintptr_t *table,
+static int get_pgtable_items(size_t left, size_t right, pte_t *table,
                              size_t *next_left, size_t *next_right)
 {
     if (left >= right) {
@@ -338,9 +624,9 @@ static int get_pgtable_items(size_t left, size_t right, uintptr_t *table,
             *next_left = left;
         }
 
-        int perm = table[left++] & PTE_FLAG_USER;
+        int perm = table[left++] & (PTE_FLAG_USER | PTE_FLAG_PS);
 
-        while (left < right && (table[left] & PTE_FLAG_USER) == perm) {
+        while (left < right && (table[left] & (PTE_FLAG_USER | PTE_FLAG_PS)) == perm) {
             left++;
         }
         
@@ -372,7 +658,8 @@ void print_pgdir()
     size_t left, right = 0, perm;
     
     pte_t *vpt = (pte_t *)KERNEL_VPT;
-    pde_t *vpd = (pde_t *)PAGE_ADDR(PD_INDEX(KERNEL_VPT), PD_INDEX(KERNEL_VPT), 0);
+    // the page directory maps itself as the PD_INDEX(KERNEL_VPT)th page table
+    pde_t *vpd = (pde_t *)(KERNEL_VPT + PD_INDEX(KERNEL_VPT) * PAGE_SIZE);
 
     // kprintf("%p %p\n", vpt, vpd);
 
@@ -382,12 +669,17 @@ void print_pgdir()
         perm = get_pgtable_items(right, PD_NENTRY, vpd, &left, &right);
         if (!perm) break;
         
-        kprintf("PDE(%03x) %08x-%08x %08x %s\n",
+        kprintf("PDE(%03x) %08x-%08x %08x %s%s\n",
                 right - left,             // page table count
                 left * PT_SIZE,           // begin addr(virtual)
                 right * PT_SIZE,          // end addr
                 (right - left) * PT_SIZE, // size
-                perm2str(perm));
+                perm2str(perm), (perm & PTE_FLAG_PS) ? " large" : "");
+        
+        if (perm & PTE_FLAG_PS) {
+            // no page tables, the vpt shows the pages themselves
+            continue;
+        }
                 
         size_t l, r = left * PT_NENTRY;
         
@@ -407,9 +699,73 @@ void print_pgdir()
     kprintf("--------------------- END ---------------------\n");
 }
 
+// page table of the kmap slots
+static pte_t *kmap_pt;
+static size_t kmap_hint = 0;
+
+static void kmap_init()
+{
+    assert(KERNEL_KMAP % PT_SIZE == 0 && KERNEL_KMAP_NSLOT <= PT_NENTRY);
+    
+    kmap_pt = get_pte(c0re_pgdir, KERNEL_KMAP, true);
+    assert(kmap_pt);
+}
+
+// map pa into a free kmap slot
+static void *kmap_slot(paddr_t pa)
+{
+    void *kva = NULL;
+    size_t i;
+    
+    no_intr_block({
+        for (i = 0; i < KERNEL_KMAP_NSLOT; i++) {
+            if (!kmap_pt[kmap_hint]) {
+                kmap_pt[kmap_hint] = pa | PTE_FLAG_P | PTE_FLAG_W;
+                kva = (void *)(KERNEL_KMAP + kmap_hint * PAGE_SIZE);
+                break;
+            }
+            
+            kmap_hint = (kmap_hint + 1) % KERNEL_KMAP_NSLOT;
+        }
+    });
+    
+    if (!kva) {
+        panic("kmap: out of slots");
+    }
+    
+    return kva;
+}
+
+// kmap - get a kernel address of page, which may be in highmem
+//      - must be paired with kunmap
+void *kmap(page_t *page)
+{
+    if (!page_isHigh(page)) {
+        return page2kva(page);
+    }
+    
+    return kmap_slot(page2pa(page));
+}
+
+// kunmap - release an address returned by kmap
+void kunmap(void *kva)
+{
+    uintptr_t va = ROUNDDOWN((uintptr_t)kva, PAGE_SIZE);
+    
+    if (va < KERNEL_KMAP || va >= KERNEL_KMAP + KERNEL_KMAP_NSLOT * PAGE_SIZE) {
+        return; // lowmem
+    }
+    
+    no_intr_block({
+        kmap_pt[(va - KERNEL_KMAP) / PAGE_SIZE] = 0;
+        invlpg((void *)va);
+    });
+}
+
 static void check_palloc();
 static void check_pgdir();
 static void check_c0re_pgdir();
+static void check_kmap();
 
 /* pmm_init - initialize the physical memory management */
 void pmm_init()
@@ -420,9 +776,18 @@ void pmm_init()
     
     check_palloc();
     
-    c0re_pgdir = page2kva(palloc_s(1));
+    c0re_pgdir = page2kva(palloc_s(PGDIR_NPAGE));
     c0re_pgdir_pa = PADDR(c0re_pgdir);
-    memset(c0re_pgdir, 0, PAGE_SIZE);
+    memset(c0re_pgdir, 0, PGDIR_NPAGE * PAGE_SIZE);
+    
+    int i;
+    
+#ifdef C0RE_PAE
+    // pdpte's only take the present bit(and the cache bits)
+    for (i = 0; i < PDPT_NENTRY; i++) {
+        c0re_pdpt[i] = (c0re_pgdir_pa + i * PAGE_SIZE) | PTE_FLAG_P;
+    }
+#endif
     
     check_pgdir();
     
@@ -432,16 +797,24 @@ void pmm_init()
     // recursively insert c0re_pgdir in itself
     // to form a virtual page table at virtual address VPT
     // NOTE: map KERNEL_VPT to the page directory itself
-    c0re_pgdir[PD_INDEX(KERNEL_VPT)] = c0re_pgdir_pa | PTE_FLAG_P | PTE_FLAG_W;
+    for (i = 0; i < VPT_NPDE; i++) {
+        c0re_pgdir[PD_INDEX(KERNEL_VPT) + i] =
+            (c0re_pgdir_pa + i * PAGE_SIZE) | PTE_FLAG_P | PTE_FLAG_W;
+    }
     
     // map all physical memory to linear memory with base linear addr KERNEL_BASE
     // linear_addr KERNEL_BASE ~ KERNEL_BASE + KERNEL_MEMSIZE = phy_addr 0 ~ KERNEL_MEMSIZE
     // but shouldn't use this map until enable_paging() & gdt_init() finished.
-    map_segment(c0re_pgdir, KERNEL_BASE, 0, KERNEL_MEMSIZE, PTE_FLAG_W);
+    map_segment(c0re_pgdir, KERNEL_BASE, 0, KERNEL_MEMSIZE, PTE_FLAG_W | PTE_FLAG_PS);
+    
+    kmap_init();
     
     // pd0 -> pd[KERNEL_BASE >> 22]
     // temp setting to keep the kernel working
-    c0re_pgdir[0] = c0re_pgdir[PD_INDEX(KERNEL_BASE)];
+    // (the first 4M is covered, which is two pde's with PAE)
+    for (i = 0; i < 0x400000 / PT_SIZE; i++) {
+        c0re_pgdir[i] = c0re_pgdir[PD_INDEX(KERNEL_BASE) + i];
+    }
     
     // NOTE: at this point, segmentation system is still working,
     // so linear address = virtual address - KERNEL_BASE
@@ -452,15 +825,24 @@ void pmm_init()
     // and the extra KERNEL_BASE will not be subtracted from the linear addres
     
     // enable paging
+#ifdef C0RE_PAE
+    page_enable(PADDR(c0re_pdpt));
+#else
     page_enable(c0re_pgdir_pa);
+#endif
 
     gdt_init();
 
     // NOTE: segmentation system is disabled(no real translation between va and la)
     // restore the page directory
-    c0re_pgdir[0] = 0;
+    for (i = 0; i < 0x400000 / PT_SIZE; i++) {
+        c0re_pgdir[i] = 0;
+    }
+    
+    tlb_flush();
 
     check_c0re_pgdir();
+    check_kmap();
     print_pgdir();
 }
 
@@ -509,6 +891,10 @@ void page_remove_pte(pde_t *pgdir, uintptr_t la, pte_t *ptep)
         
         *ptep = 0;
         tlb_invalidate(pgdir, la);
+    } else if (*ptep) {
+        // swapped out
+        swap_free(*ptep);
+        *ptep = 0;
     }
 }
 
@@ -563,7 +949,7 @@ int page_insert(pde_t *pgdir, page_t *page, uintptr_t la, uint32_t perm)
 page_t *pgdir_palloc(pde_t *pgdir, uintptr_t la, uint32_t perm)
 {
     extern vma_set_t *c0re_check_vma_set;
-    page_t *page = palloc(1);
+    page_t *page = palloc_high();
     
     if (page) {
         if (page_insert(pgdir, page, la, perm)) {
@@ -593,11 +979,24 @@ page_t *pgdir_palloc(pde_t *pgdir, uintptr_t la, uint32_t perm)
 // TODO: wtf is this???
 void tlb_invalidate(pde_t *pgdir, uintptr_t la)
 {
-    if (rcr3() == PADDR(pgdir)) {
+#ifdef C0RE_PAE
+    // cr3 has the pdpt, whose first entry points to the page directory
+    bool cur = PDE_ADDR(((pdpte_t *)KADDR(rcr3()))[0]) == PADDR(pgdir);
+#else
+    bool cur = rcr3() == PADDR(pgdir);
+#endif
+
+    if (cur) {
         invlpg((void *)la);
     }
 }
 
+// flush all non-global TLB entries
+void tlb_flush()
+{
+    lcr3(rcr3());
+}
+
 static void check_palloc()
 {
     page_alloc->check();
@@ -606,7 +1005,7 @@ static void check_palloc()
 
 static void check_pgdir()
 {
-    assert(c0re_npage <= KERNEL_MEMSIZE / PAGE_SIZE);
+    assert(c0re_npage_low <= KERNEL_MEMSIZE / PAGE_SIZE);
     
     assert(c0re_pgdir != NULL && (uint32_t)PAGE_OFS(c0re_pgdir) == 0);
     assert(get_page(c0re_pgdir, 0x0, NULL) == NULL);
@@ -660,11 +1059,20 @@ static void check_c0re_pgdir()
     int i;
     
     for (i = 0; i < c0re_npage; i += PAGE_SIZE) {
-        assert((ptep = get_pte(c0re_pgdir, (uintptr_t)KADDR(i), 0)) != NULL);
-        assert(PTE_ADDR(*ptep) == i);
+        pde_t pde = c0re_pgdir[PD_INDEX(KADDR(i))];
+        
+        if (pde & PTE_FLAG_PS) {
+            assert(get_pte(c0re_pgdir, (uintptr_t)KADDR(i), 0) == NULL);
+            assert(PDE_ADDR_LARGE(pde) == ROUNDDOWN(i, PT_SIZE));
+        } else {
+            assert((ptep = get_pte(c0re_pgdir, (uintptr_t)KADDR(i), 0)) != NULL);
+            assert(PTE_ADDR(*ptep) == i);
+        }
     }
 
-    assert(PDE_ADDR(c0re_pgdir[PD_INDEX(KERNEL_VPT)]) == PADDR(c0re_pgdir));
+    for (i = 0; i < VPT_NPDE; i++) {
+        assert(PDE_ADDR(c0re_pgdir[PD_INDEX(KERNEL_VPT) + i]) == PADDR(c0re_pgdir) + i * PAGE_SIZE);
+    }
 
     assert(c0re_pgdir[0] == 0);
 
@@ -688,3 +1096,39 @@ static void check_c0re_pgdir()
 
     trace("check success: c0re_pgdir");
 }
+
+static void check_kmap()
+{
+    page_t *p = palloc_s(1);
+    char *kva = page2kva(p), *slot;
+    
+    assert(kmap(p) == kva);
+    kunmap(kva);
+    
+    // go through a slot even if there is no highmem
+    slot = kmap_slot(page2pa(p));
+    
+    assert(slot != kva);
+    assert((uintptr_t)slot >= KERNEL_KMAP);
+    
+    strcpy(slot, "kmap");
+    assert(strcmp(kva, "kmap") == 0);
+    
+    kunmap(slot);
+    assert(!kmap_pt[((uintptr_t)slot - KERNEL_KMAP) / PAGE_SIZE]);
+    
+    pfree(p);
+    
+    if (high_area.nfree) {
+        p = palloc_high();
+        assert(page_isHigh(p));
+        
+        slot = kmap(p);
+        memset(slot, 0, PAGE_SIZE);
+        kunmap(slot);
+        
+        pfree(p);
+    }
+    
+    trace("check success: kmap");
+}
@@ -28,8 +28,9 @@ typedef struct {
 
 extern page_t *c0re_pages;
 extern size_t c0re_npage;
+extern size_t c0re_npage_low; // pages below this are mapped at KERNEL_BASE
 extern pde_t *c0re_pgdir;
-extern uintptr_t c0re_pgdir_pa;
+extern paddr_t c0re_pgdir_pa;
 
 /**
  * PADDR - takes a kernel virtual address (an address that points above KERNBASE),
@@ -48,13 +49,13 @@ extern uintptr_t c0re_pgdir_pa;
  * KADDR - takes a physical address and returns the corresponding kernel virtual
  * address. it panicks if you pass an invalid physical address.
  **/
-#define KADDR(pa) ({                                             \
-        uintptr_t __m_pa = (pa);                                 \
-        size_t __m_ppn = PAGE_NUMBER(__m_pa);                    \
-        if (__m_ppn >= c0re_npage) {                             \
-            panic("KADDR called with invalid pa %08lx", __m_pa); \
-        }                                                        \
-        (void *)(__m_pa + KERNEL_BASE);                          \
+#define KADDR(pa) ({                                                     \
+        paddr_t __m_pa = (pa);                                           \
+        size_t __m_ppn = PAGE_NUMBER(__m_pa);                            \
+        if (__m_ppn >= c0re_npage_low) {                                 \
+            panic("KADDR called with invalid pa %llx", (uint64_t)__m_pa); \
+        }                                                                \
+        (void *)((uintptr_t)__m_pa + KERNEL_BASE);                       \
     })
     
 C0RE_INLINE
@@ -65,13 +66,13 @@ page_number_t page2ppn(page_t *page)
 
 // pa for physical address
 C0RE_INLINE
-uintptr_t page2pa(page_t *page)
+paddr_t page2pa(page_t *page)
 {
-    return page2ppn(page) << PAGE_SHIFT;
+    return (paddr_t)page2ppn(page) << PAGE_SHIFT;
 }
 
 C0RE_INLINE
-page_t *pa2page(uintptr_t pa)
+page_t *pa2page(paddr_t pa)
 {
     if (PAGE_NUMBER(pa) >= c0re_npage) {
         panic("pa2page called with invalid physical address");
@@ -80,6 +81,13 @@ page_t *pa2page(uintptr_t pa)
     return &c0re_pages[PAGE_NUMBER(pa)];
 }
 
+// highmem pages have no kernel address, see kmap
+C0RE_INLINE
+bool page_isHigh(page_t *page)
+{
+    return page2ppn(page) >= c0re_npage_low;
+}
+
 C0RE_INLINE
 void *page2kva(page_t *page)
 {
@@ -113,6 +121,11 @@ void pmm_init();
 pte_t *get_pte(pde_t *pgdir, uintptr_t la, bool create);
 
 page_t *palloc(size_t n);
+bool palloc_reclaim(size_t n, page_t *base, size_t npage);
+size_t palloc_batch(page_t **pages, size_t n);
+page_t *palloc_high();
+page_t *palloc_try();
+page_t *palloc_low_try();
 void pfree(page_t *base);
 size_t nfpage(); // # of free pages
 
@@ -128,12 +141,17 @@ page_t *palloc_s(size_t n)
     return npg;
 }
 
+void *kmap(page_t *page);
+void kunmap(void *kva);
+
 void *kmalloc(size_t n);
 void kfree(void *ptr, size_t n);
 
+page_t *get_page(pde_t *pgdir, uintptr_t la, pte_t **ptep_result);
 page_t *pgdir_palloc(pde_t *pgdir, uintptr_t la, uint32_t perm);
 int page_insert(pde_t *pgdir, page_t *page, uintptr_t la, uint32_t perm);
 void page_remove(pde_t *pgdir, uintptr_t la);
 void tlb_invalidate(pde_t *pgdir, uintptr_t la);
+void tlb_flush();
 
 #endif
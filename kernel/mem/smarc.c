@@ -0,0 +1,356 @@
+#include "pub/com.h"
+#include "pub/dllist.h"
+#include "pub/error.h"
+#include "pub/string.h"
+
+#include "lib/debug.h"
+
+#include "mem/smarc.h"
+
+/**
+ * resident pages are in t1 if they've been used once, and in t2 if they've
+ * been used again since they came in. a victim is taken from t1 while it's
+ * bigger than the target p, from t2 otherwise. so a scan through many
+ * pages only goes through t1, and leaves the pages in t2 alone.
+ *
+ * there is no hook on every access, the accessed bit is looked at when
+ * the victim is chosen(like CAR): a page in t1 with the bit set moves to
+ * t2, a page in t2 with the bit set gets a second chance. the fault that
+ * brings a page in sets the bit as well, whether it goes to t1 or straight
+ * to t2, it's cleared by the next sweep or tick(nfresh, nfresh2), so only
+ * a later access counts.
+ *
+ * b1 and b2 remember the addresses of pages evicted from t1 and t2. a page
+ * swapped in from b1 was evicted too early from t1, p grows; one from b2
+ * means t2 needs room, p shrinks. both go to t2.
+ **/
+
+// addresses of evicted pages, 0 for one taken back
+typedef struct {
+    uintptr_t addr[SMARC_GHOST_NENTRY];
+    size_t head;            // where the next one goes
+    size_t len;             // the oldest is len entries before head
+    size_t nlive;
+} smarc_ghost_t;
+
+// state of each vma set
+typedef struct {
+    dllist_t t1, t2;        // the newest at the head
+    size_t nt1, nt2;
+    size_t nfresh;          // pages at the head of t1 not aged yet
+    size_t nfresh2;         // same for t2, the ones back from a ghost list
+    size_t p;               // target size of t1
+    smarc_ghost_t b1, b2;
+} smarc_set_t;
+
+static size_t smarc_nghost1 = 0, smarc_nghost2 = 0;
+
+// drop the oldest address
+static void smarc_ghostPop(smarc_ghost_t *ghost)
+{
+    size_t idx = (ghost->head + SMARC_GHOST_NENTRY - ghost->len) % SMARC_GHOST_NENTRY;
+    
+    assert(ghost->len);
+    
+    if (ghost->addr[idx]) {
+        ghost->addr[idx] = 0;
+        ghost->nlive--;
+    }
+    
+    ghost->len--;
+}
+
+// remember addr, keep at most limit addresses
+static void smarc_ghostAdd(smarc_ghost_t *ghost, uintptr_t addr, size_t limit)
+{
+    if (ghost->len == SMARC_GHOST_NENTRY) {
+        smarc_ghostPop(ghost);
+    }
+    
+    ghost->addr[ghost->head] = addr;
+    ghost->head = (ghost->head + 1) % SMARC_GHOST_NENTRY;
+    ghost->len++;
+    ghost->nlive++;
+    
+    while (ghost->nlive > limit) {
+        smarc_ghostPop(ghost);
+    }
+}
+
+// forget addr
+// return value: whether it was there
+static bool smarc_ghostTake(smarc_ghost_t *ghost, uintptr_t addr)
+{
+    size_t i, idx;
+    
+    for (i = 0; i < ghost->len; i++) {
+        idx = (ghost->head + SMARC_GHOST_NENTRY - 1 - i) % SMARC_GHOST_NENTRY;
+    
+        if (ghost->addr[idx] == addr) {
+            ghost->addr[idx] = 0;
+            ghost->nlive--;
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+static int smarc_init()
+{
+    return 0;
+}
+
+static int smarc_initVMASet(vma_set_t *set)
+{
+    smarc_set_t *arc = kmalloc(sizeof(*arc));
+    
+    if (!arc) {
+        return -E_NO_MEM;
+    }
+    
+    memset(arc, 0, sizeof(*arc));
+    
+    dllist_init(&(arc->t1));
+    dllist_init(&(arc->t2));
+    set->swap_data = arc;
+    
+    trace("smarc: init arc %p", (void *)arc);
+    
+    return 0;
+}
+
+static int smarc_exitVMASet(vma_set_t *set)
+{
+    kfree(set->swap_data, sizeof(smarc_set_t));
+    set->swap_data = NULL;
+    
+    return 0;
+}
+
+static int smarc_mapSwappable(vma_set_t *set, uintptr_t addr,
+                              page_t *page, int swap_in)
+{
+    smarc_set_t *arc = set->swap_data;
+    size_t c, n1, n2, delta;
+    
+    assert(arc);
+    
+    c = arc->nt1 + arc->nt2 + 1;
+    n1 = arc->b1.nlive;
+    n2 = arc->b2.nlive;
+    
+    if (swap_in && smarc_ghostTake(&(arc->b1), addr)) {
+        delta = n2 > n1 ? n2 / n1 : 1;
+        arc->p = arc->p + delta < c ? arc->p + delta : c;
+        smarc_nghost1++;
+    } else if (swap_in && smarc_ghostTake(&(arc->b2), addr)) {
+        delta = n1 > n2 ? n1 / n2 : 1;
+        arc->p = arc->p > delta ? arc->p - delta : 0;
+        smarc_nghost2++;
+    } else {
+        dllist_add(&(arc->t1), &(page->pra_link));
+        arc->nt1++;
+        arc->nfresh++;
+    
+        return 0;
+    }
+    
+    dllist_add(&(arc->t2), &(page->pra_link));
+    page_setActive(page);
+    arc->nt2++;
+    arc->nfresh2++;
+    
+    return 0;
+}
+
+// whether page is one of the first n pages of list
+static bool smarc_inHead(dllist_t *list, size_t n, page_t *page)
+{
+    dllist_t *cur = list->next;
+    
+    for (; n && cur != list; n--, cur = cur->next) {
+        if (cur == &(page->pra_link)) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+static int smarc_setUnswappable(vma_set_t *set, uintptr_t addr)
+{
+    smarc_set_t *arc = set->swap_data;
+    page_t *page = get_page(set->pgdir, addr, NULL);
+    
+    assert(arc && page);
+    
+    // the fresh pages stay at the heads
+    if (page_isActive(page)) {
+        if (smarc_inHead(&(arc->t2), arc->nfresh2, page)) {
+            arc->nfresh2--;
+        }
+        
+        page_resetActive(page);
+        arc->nt2--;
+    } else {
+        if (smarc_inHead(&(arc->t1), arc->nfresh, page)) {
+            arc->nfresh--;
+        }
+        
+        arc->nt1--;
+    }
+    
+    dllist_del(&(page->pra_link));
+    
+    return 0;
+}
+
+// clear the accessed bits of the first n pages of list
+static void smarc_ageHead(vma_set_t *set, dllist_t *list, size_t n, swap_flush_t *flush)
+{
+    dllist_t *cur = list->next;
+    
+    for (; n && cur != list; n--, cur = cur->next) {
+        swap_clearRef(set, dll2page(cur, pra_link), flush);
+    }
+}
+
+// forget the accesses made by the faults that brought pages in
+static void smarc_age(vma_set_t *set, smarc_set_t *arc, swap_flush_t *flush)
+{
+    smarc_ageHead(set, &(arc->t1), arc->nfresh, flush);
+    smarc_ageHead(set, &(arc->t2), arc->nfresh2, flush);
+    
+    arc->nfresh = arc->nfresh2 = 0;
+}
+
+static int smarc_swapOut(vma_set_t *set, page_t **result, int in_tick)
+{
+    smarc_set_t *arc = set->swap_data;
+    swap_flush_t flush = { .n = 0 };
+    page_t *page;
+    
+    assert(arc);
+    
+    if (!arc->nt1 && !arc->nt2) {
+        return -E_NO_MEM;
+    }
+    
+    smarc_age(set, arc, &flush);
+    
+    // terminates within two rounds since every bit passed is cleared
+    while (1) {
+        if (arc->nt1 && (arc->nt1 >= (arc->p ? arc->p : 1) || !arc->nt2)) {
+            page = dll2page(arc->t1.prev, pra_link);
+    
+            if (!swap_clearRef(set, page, &flush)) {
+                arc->nt1--;
+                smarc_ghostAdd(&(arc->b1), page->pra_vaddr, arc->nt1 + arc->nt2 + 1);
+                break;
+            }
+    
+            // used again
+            dllist_del(&(page->pra_link));
+            dllist_add(&(arc->t2), &(page->pra_link));
+            page_setActive(page);
+    
+            arc->nt1--;
+            arc->nt2++;
+        } else {
+            page = dll2page(arc->t2.prev, pra_link);
+    
+            if (!swap_clearRef(set, page, &flush)) {
+                arc->nt2--;
+                page_resetActive(page);
+                smarc_ghostAdd(&(arc->b2), page->pra_vaddr, arc->nt1 + arc->nt2 + 1);
+                break;
+            }
+    
+            dllist_del(&(page->pra_link));
+            dllist_add(&(arc->t2), &(page->pra_link));
+        }
+    }
+    
+    swap_flush(set, &flush);
+    
+    dllist_del(&(page->pra_link));
+    *result = page;
+    
+    return 0;
+}
+
+static int smarc_tick(vma_set_t *set)
+{
+    smarc_set_t *arc = set->swap_data;
+    swap_flush_t flush = { .n = 0 };
+    
+    assert(arc);
+    
+    smarc_age(set, arc, &flush);
+    swap_flush(set, &flush);
+    
+    return 0;
+}
+
+static void smarc_dumpStat(vma_set_t *set)
+{
+    smarc_set_t *arc = set->swap_data;
+    
+    kprintf(DBG_TAB "arc of set %p: p %u, t1 %u, t2 %u, ghost hits %u/%u\n",
+            set, arc->p, arc->nt1, arc->nt2, smarc_nghost1, smarc_nghost2);
+}
+
+// starting with 0x1000 - 0x4000 resident in t1 and fresh
+static int smarc_check()
+{
+    size_t init = vmm_getPageFaultCount();
+    
+    // the accesses that brought them in don't count, 0x1000 goes
+    *(unsigned char *)0x5000 = 0x0e;
+    assert(vmm_getPageFaultCount() - init == 1);
+    
+    *(unsigned char *)0x2000 = 0x0b;
+    assert(vmm_getPageFaultCount() - init == 1);
+    
+    // 0x1000 comes back from b1 to t2, 0x2000 moves to t2, 0x3000 goes
+    *(unsigned char *)0x1000 = 0x0a;
+    assert(vmm_getPageFaultCount() - init == 2);
+    
+    // back from b1 as well, p is 2 now and t1 gives 0x4000
+    *(unsigned char *)0x3000 = 0x0c;
+    assert(vmm_getPageFaultCount() - init == 3);
+    
+    *(unsigned char *)0x2000 = 0x0b;
+    assert(vmm_getPageFaultCount() - init == 3);
+    
+    // t1 is below p, in t2 0x2000 gets a second chance, but 0x1000 isn't
+    // used since the fault that brought it back, so it goes
+    *(unsigned char *)0x4000 = 0x0d;
+    assert(vmm_getPageFaultCount() - init == 4);
+    
+    // back from b2, 0x3000 isn't used since it came back either
+    assert(*(unsigned char *)0x1000 == 0x0a);
+    assert(vmm_getPageFaultCount() - init == 5);
+    
+    assert(*(unsigned char *)0x2000 == 0x0b);
+    assert(vmm_getPageFaultCount() - init == 5);
+    
+    return 0;
+}
+
+swap_manager_t swap_manager_arc = {
+     .name            = "arc swap manager",
+    
+     .init            = &smarc_init,
+     .initVMASet      = &smarc_initVMASet,
+     .exitVMASet      = &smarc_exitVMASet,
+    
+     .tick            = &smarc_tick,
+     .dumpStat        = &smarc_dumpStat,
+     .mapSwappable    = &smarc_mapSwappable,
+     .setUnswappable  = &smarc_setUnswappable,
+     .swapOut         = &smarc_swapOut,
+    
+     .check           = &smarc_check
+};
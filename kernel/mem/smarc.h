@@ -0,0 +1,13 @@
+#ifndef _KERNEL_MEM_SMARC_H_
+#define _KERNEL_MEM_SMARC_H_
+
+/* swap manager using ARC(adaptive replacement cache), clock style */
+
+#include "mem/swap.h"
+
+// evicted pages remembered in each ghost list at most
+#define SMARC_GHOST_NENTRY 256
+
+extern swap_manager_t swap_manager_arc;
+
+#endif
@@ -0,0 +1,200 @@
+#include "pub/com.h"
+#include "pub/dllist.h"
+#include "pub/error.h"
+
+#include "lib/debug.h"
+
+#include "mem/smclock.h"
+
+/**
+ * pages form a circle through pra_link, the hand points to the next page
+ * to look at. a page with PTE_FLAG_A set gets a second chance: the bit
+ * is cleared and the hand moves on, the first page found unreferenced
+ * is the victim. new pages are put right behind the hand.
+ *
+ * the tick clears the bits of the pages right in front of the hand, so
+ * by the time the hand gets there only pages used since are spared and
+ * the sweep in swapOut is short.
+ **/
+
+// state of each vma set
+typedef struct {
+    dllist_t head;
+    dllist_t *hand;
+} smclock_set_t;
+
+static int smclock_init()
+{
+    return 0;
+}
+
+static int smclock_initVMASet(vma_set_t *set)
+{
+    smclock_set_t *clock = kmalloc(sizeof(*clock));
+    
+    if (!clock) {
+        return -E_NO_MEM;
+    }
+    
+    dllist_init(&(clock->head));
+    clock->hand = &(clock->head);
+    set->swap_data = clock;
+    
+    trace("smclock: init clock %p", (void *)clock);
+    
+    return 0;
+}
+
+static int smclock_exitVMASet(vma_set_t *set)
+{
+    kfree(set->swap_data, sizeof(smclock_set_t));
+    set->swap_data = NULL;
+    
+    return 0;
+}
+
+static int smclock_mapSwappable(vma_set_t *set, uintptr_t addr,
+                                page_t *page, int swap_in)
+{
+    smclock_set_t *clock = set->swap_data;
+    dllist_t *entry = &(page->pra_link);
+
+    assert(clock && entry);
+    
+    // the last one the hand will reach
+    dllist_add_before(clock->hand, entry);
+    
+    return 0;
+}
+
+static int smclock_setUnswappable(vma_set_t *set, uintptr_t addr)
+{
+    smclock_set_t *clock = set->swap_data;
+    page_t *page = get_page(set->pgdir, addr, NULL);
+    
+    assert(page);
+    
+    if (clock->hand == &(page->pra_link)) {
+        clock->hand = clock->hand->next;
+    }
+    
+    dllist_del(&(page->pra_link));
+    
+    return 0;
+}
+
+static int smclock_swapOut(vma_set_t *set, page_t **result, int in_tick)
+{
+    smclock_set_t *clock = set->swap_data;
+    dllist_t *head = &(clock->head);
+    swap_flush_t flush = { .n = 0 };
+    
+    page_t *p = NULL;
+
+    if (dllist_empty(head)) {
+        return -E_NO_MEM;
+    }
+    
+    // terminates within one round since every bit passed is cleared
+    while (!p) {
+        if (clock->hand == head) {
+            clock->hand = head->next;
+        }
+        
+        page_t *page = dll2page(clock->hand, pra_link);
+        
+        clock->hand = clock->hand->next;
+        
+        if (!swap_clearRef(set, page, &flush)) {
+            p = page;
+        }
+    }
+    
+    swap_flush(set, &flush);
+    
+    dllist_del(&(p->pra_link));
+    *result = p;
+
+    return 0;
+}
+
+// age the pages the hand gets to next
+static int smclock_tick(vma_set_t *set)
+{
+    smclock_set_t *clock = set->swap_data;
+    dllist_t *head = &(clock->head), *cur = clock->hand;
+    swap_flush_t flush = { .n = 0 };
+    size_t i;
+    
+    if (dllist_empty(head)) {
+        return 0;
+    }
+    
+    for (i = 0; i < SMCLOCK_TICK_NPAGE; i++, cur = cur->next) {
+        if (cur == head) {
+            cur = head->next;
+        }
+        
+        swap_clearRef(set, dll2page(cur, pra_link), &flush);
+    }
+    
+    swap_flush(set, &flush);
+    
+    return 0;
+}
+
+// starting with 0x1000 - 0x4000 resident and referenced
+static int smclock_check()
+{
+    size_t init = vmm_getPageFaultCount();
+    
+    // all referenced, a full round is made and 0x1000 goes
+    *(unsigned char *)0x5000 = 0x0e;
+    assert(vmm_getPageFaultCount() - init == 1);
+
+    *(unsigned char *)0x2000 = 0x0b;
+    assert(vmm_getPageFaultCount() - init == 1);
+
+    // 0x2000 is spared
+    *(unsigned char *)0x1000 = 0x0a;
+    assert(vmm_getPageFaultCount() - init == 2);
+
+    *(unsigned char *)0x3000 = 0x0c;
+    assert(vmm_getPageFaultCount() - init == 3);
+
+    *(unsigned char *)0x2000 = 0x0b;
+    assert(vmm_getPageFaultCount() - init == 3);
+
+    *(unsigned char *)0x4000 = 0x0d;
+    assert(vmm_getPageFaultCount() - init == 4);
+
+    // 0x2000 is spared again, 0x1000 is not
+    *(unsigned char *)0x2000 = 0x0b;
+    assert(vmm_getPageFaultCount() - init == 4);
+
+    *(unsigned char *)0x5000 = 0x0e;
+    assert(vmm_getPageFaultCount() - init == 5);
+
+    *(unsigned char *)0x2000 = 0x0b;
+    assert(vmm_getPageFaultCount() - init == 5);
+
+    assert(*(unsigned char *)0x1000 == 0x0a);
+    assert(vmm_getPageFaultCount() - init == 6);
+
+    return 0;
+}
+
+swap_manager_t swap_manager_clock = {
+     .name            = "clock swap manager",
+     
+     .init            = &smclock_init,
+     .initVMASet      = &smclock_initVMASet,
+     .exitVMASet      = &smclock_exitVMASet,
+     
+     .tick            = &smclock_tick,
+     .mapSwappable    = &smclock_mapSwappable,
+     .setUnswappable  = &smclock_setUnswappable,
+     .swapOut         = &smclock_swapOut,
+     
+     .check           = &smclock_check
+};
@@ -0,0 +1,13 @@
+#ifndef _KERNEL_MEM_SMCLOCK_H_
+#define _KERNEL_MEM_SMCLOCK_H_
+
+/* swap manager using the clock(second chance) algorithm */
+
+#include "mem/swap.h"
+
+// pages in front of the hand aged by each tick
+#define SMCLOCK_TICK_NPAGE 16
+
+extern swap_manager_t swap_manager_clock;
+
+#endif
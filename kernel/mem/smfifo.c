@@ -1,23 +1,37 @@
 #include "pub/com.h"
 #include "pub/dllist.h"
+#include "pub/error.h"
 
 #include "lib/debug.h"
 
 #include "mem/smfifo.h"
 
-static dllist_t fifo_head;
-
 static int smfifo_init()
 {
     return 0;
 }
 
+// each vma set has its own queue
 static int smfifo_initVMASet(vma_set_t *set)
 {
-    dllist_init(&fifo_head);
-    set->swap_data = &fifo_head;
+    dllist_t *head = kmalloc(sizeof(*head));
+    
+    if (!head) {
+        return -E_NO_MEM;
+    }
     
-    trace("smfifo: init fifo_head %p", (void *)&fifo_head);
+    dllist_init(head);
+    set->swap_data = head;
+    
+    trace("smfifo: init fifo_head %p", (void *)head);
+    
+    return 0;
+}
+
+static int smfifo_exitVMASet(vma_set_t *set)
+{
+    kfree(set->swap_data, sizeof(dllist_t));
+    set->swap_data = NULL;
     
     return 0;
 }
@@ -37,6 +51,11 @@ static int smfifo_mapSwappable(vma_set_t *set, uintptr_t addr,
 
 static int smfifo_setUnswappable(vma_set_t *set, uintptr_t addr)
 {
+    page_t *page = get_page(set->pgdir, addr, NULL);
+    
+    assert(page);
+    dllist_del(&(page->pra_link));
+    
     return 0;
 }
 
@@ -45,7 +64,10 @@ static int smfifo_swapOut(vma_set_t *set, page_t **result, int in_tick)
     dllist_t *head = (dllist_t *)set->swap_data;
 
     assert(head);
-    assert(in_tick == 0);
+    
+    if (dllist_empty(head)) {
+        return -E_NO_MEM;
+    }
     
      /* Select the victim */
      /*LAB3 EXERCISE 2: YOUR CODE*/ 
@@ -54,9 +76,6 @@ static int smfifo_swapOut(vma_set_t *set, page_t **result, int in_tick)
      
     /* Select the tail */
     dllist_t *dll = head->prev;
-    
-    assert(head != dll);
-    
     page_t *p = dll2page(dll, pra_link);
     dllist_del(dll);
     
@@ -121,6 +140,7 @@ swap_manager_t swap_manager_fifo = {
      
      .init            = &smfifo_init,
      .initVMASet      = &smfifo_initVMASet,
+     .exitVMASet      = &smfifo_exitVMASet,
      
      .tick            = &smfifo_tick,
      .mapSwappable    = &smfifo_mapSwappable,
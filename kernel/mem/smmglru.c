@@ -0,0 +1,287 @@
+#include "pub/com.h"
+#include "pub/dllist.h"
+#include "pub/error.h"
+
+#include "lib/debug.h"
+
+#include "mem/smmglru.h"
+
+/**
+ * pages are in generations numbered by a sequence, min_seq is the oldest
+ * and max_seq the youngest one, each kept in gen[seq % SMMGLRU_NGEN].
+ *
+ * aging makes a new youngest generation and walks the page tables of the
+ * set: every pte with PTE_FLAG_A set is cleared and its page moves to the
+ * new generation. ptes are read in address order, a page table at a time,
+ * instead of following each page to its pte. it's done by the tick, and
+ * by swapOut when only one generation is left, so there are always old
+ * pages to tell from young ones.
+ *
+ * the victim is the tail of the oldest generation. a page used since the
+ * last walk is moved to the youngest one instead.
+ **/
+
+// state of each vma set
+typedef struct {
+    dllist_t gen[SMMGLRU_NGEN];     // the newest at the head of each
+    size_t min_seq, max_seq;
+} smmglru_set_t;
+
+static size_t smmglru_nwalk = 0, smmglru_nscan = 0, smmglru_npromote = 0;
+
+#define smmglru_gen(lru, seq) (&((lru)->gen[(seq) % SMMGLRU_NGEN]))
+
+static int smmglru_init()
+{
+    return 0;
+}
+
+static int smmglru_initVMASet(vma_set_t *set)
+{
+    smmglru_set_t *lru = kmalloc(sizeof(*lru));
+    size_t i;
+    
+    if (!lru) {
+        return -E_NO_MEM;
+    }
+    
+    for (i = 0; i < SMMGLRU_NGEN; i++) {
+        dllist_init(&(lru->gen[i]));
+    }
+    
+    lru->min_seq = lru->max_seq = 0;
+    set->swap_data = lru;
+    
+    trace("smmglru: init lru %p", (void *)lru);
+    
+    return 0;
+}
+
+static int smmglru_exitVMASet(vma_set_t *set)
+{
+    kfree(set->swap_data, sizeof(smmglru_set_t));
+    set->swap_data = NULL;
+    
+    return 0;
+}
+
+static int smmglru_mapSwappable(vma_set_t *set, uintptr_t addr,
+                                page_t *page, int swap_in)
+{
+    smmglru_set_t *lru = set->swap_data;
+    
+    assert(lru);
+    
+    dllist_add(smmglru_gen(lru, lru->max_seq), &(page->pra_link));
+    
+    return 0;
+}
+
+static int smmglru_setUnswappable(vma_set_t *set, uintptr_t addr)
+{
+    page_t *page = get_page(set->pgdir, addr, NULL);
+    
+    assert(page);
+    
+    dllist_del(&(page->pra_link));
+    
+    return 0;
+}
+
+// walk the ptes of the vmas of set, referenced pages go to the youngest generation
+static void smmglru_walk(vma_set_t *set, smmglru_set_t *lru, swap_flush_t *flush)
+{
+    dllist_t *list = &(set->mset), *cur = list, *young = smmglru_gen(lru, lru->max_seq);
+    
+    while ((cur = dllist_next(cur)) != list) {
+        vma_t *vma = dll2vma(cur, link);
+        uintptr_t addr = ROUNDDOWN(vma->start, PAGE_SIZE), end;
+        
+        for (; addr < vma->end; addr = end) {
+            // the rest of the ptes of this page table follow the first one
+            pte_t *ptep = get_pte(set->pgdir, addr, 0);
+            
+            end = ROUNDDOWN(addr, PT_SIZE) + PT_SIZE;
+            
+            if (end > vma->end || end == 0) {
+                end = vma->end;
+            }
+            
+            // no page table, or a large page that is never swapped
+            if (!ptep) {
+                continue;
+            }
+            
+            for (; addr < end; addr += PAGE_SIZE, ptep++) {
+                smmglru_nscan++;
+                
+                if (!(*ptep & PTE_FLAG_P)) {
+                    continue;
+                }
+                
+                page_t *page = pte2page(*ptep);
+                
+                if (!page_isSwap(page) || !swap_clearPteRef(ptep, addr, flush)) {
+                    continue;
+                }
+                
+                dllist_del(&(page->pra_link));
+                dllist_add(young, &(page->pra_link));
+                smmglru_npromote++;
+            }
+        }
+    }
+}
+
+// make a new youngest generation and fill it by a walk
+static void smmglru_age(vma_set_t *set, smmglru_set_t *lru)
+{
+    swap_flush_t flush = { .n = 0 };
+    dllist_t *oldest = smmglru_gen(lru, lru->min_seq), *next;
+    
+    if (lru->max_seq - lru->min_seq + 1 == SMMGLRU_NGEN) {
+        // no room, the oldest pages join the tail of the next generation
+        next = smmglru_gen(lru, lru->min_seq + 1);
+        
+        while (!dllist_empty(oldest)) {
+            dllist_t *entry = dllist_next(oldest);
+            
+            dllist_del(entry);
+            dllist_add_before(next, entry);
+        }
+        
+        lru->min_seq++;
+    }
+    
+    lru->max_seq++;
+    smmglru_walk(set, lru, &flush);
+    smmglru_nwalk++;
+    
+    swap_flush(set, &flush);
+}
+
+// skip the empty generations at the old end
+// return value: whether any page is left
+static bool smmglru_trim(smmglru_set_t *lru)
+{
+    while (dllist_empty(smmglru_gen(lru, lru->min_seq)) && lru->min_seq < lru->max_seq) {
+        lru->min_seq++;
+    }
+    
+    return !dllist_empty(smmglru_gen(lru, lru->min_seq));
+}
+
+static int smmglru_swapOut(vma_set_t *set, page_t **result, int in_tick)
+{
+    smmglru_set_t *lru = set->swap_data;
+    swap_flush_t flush = { .n = 0 };
+    page_t *page;
+    
+    assert(lru);
+    
+    if (!smmglru_trim(lru)) {
+        return -E_NO_MEM;
+    }
+    
+    if (lru->min_seq == lru->max_seq) {
+        smmglru_age(set, lru);
+        smmglru_trim(lru);
+    }
+    
+    // terminates since every bit passed is cleared
+    while (1) {
+        page = dll2page(smmglru_gen(lru, lru->min_seq)->prev, pra_link);
+        
+        if (!swap_clearRef(set, page, &flush)) {
+            break;
+        }
+        
+        // used since the last walk
+        dllist_del(&(page->pra_link));
+        dllist_add(smmglru_gen(lru, lru->max_seq), &(page->pra_link));
+        smmglru_npromote++;
+        
+        smmglru_trim(lru);
+    }
+    
+    swap_flush(set, &flush);
+    
+    dllist_del(&(page->pra_link));
+    *result = page;
+    
+    return 0;
+}
+
+static int smmglru_tick(vma_set_t *set)
+{
+    smmglru_set_t *lru = set->swap_data;
+    
+    if (smmglru_trim(lru)) {
+        smmglru_age(set, lru);
+    }
+    
+    return 0;
+}
+
+static void smmglru_dumpStat(vma_set_t *set)
+{
+    smmglru_set_t *lru = set->swap_data;
+    
+    kprintf(DBG_TAB "mglru of set %p: seq %u - %u, %u walks, %u ptes scanned, %u pages promoted\n",
+            set, lru->min_seq, lru->max_seq, smmglru_nwalk, smmglru_nscan, smmglru_npromote);
+}
+
+// starting with 0x1000 - 0x4000 resident and referenced, in one generation
+static int smmglru_check()
+{
+    size_t init = vmm_getPageFaultCount();
+    
+    // the walk moves all of them to a new generation, 0x1000 was mapped first
+    *(unsigned char *)0x5000 = 0x0e;
+    assert(vmm_getPageFaultCount() - init == 1);
+    
+    *(unsigned char *)0x2000 = 0x0b;
+    assert(vmm_getPageFaultCount() - init == 1);
+    
+    // 0x2000 and 0x5000 are moved on by the next walk, 0x3000 goes
+    *(unsigned char *)0x1000 = 0x0a;
+    assert(vmm_getPageFaultCount() - init == 2);
+    
+    *(unsigned char *)0x3000 = 0x0c;
+    assert(vmm_getPageFaultCount() - init == 3);
+    
+    *(unsigned char *)0x2000 = 0x0b;
+    assert(vmm_getPageFaultCount() - init == 3);
+    
+    // 0x5000 is the only one not used since the last walk
+    *(unsigned char *)0x4000 = 0x0d;
+    assert(vmm_getPageFaultCount() - init == 4);
+    
+    // the least recently used one goes, 0x1000
+    assert(*(unsigned char *)0x5000 == 0x0e);
+    assert(vmm_getPageFaultCount() - init == 5);
+    
+    assert(*(unsigned char *)0x2000 == 0x0b);
+    assert(vmm_getPageFaultCount() - init == 5);
+    
+    assert(*(unsigned char *)0x1000 == 0x0a);
+    assert(vmm_getPageFaultCount() - init == 6);
+    
+    return 0;
+}
+
+swap_manager_t swap_manager_mglru = {
+     .name            = "mglru swap manager",
+     
+     .init            = &smmglru_init,
+     .initVMASet      = &smmglru_initVMASet,
+     .exitVMASet      = &smmglru_exitVMASet,
+     
+     .tick            = &smmglru_tick,
+     .dumpStat        = &smmglru_dumpStat,
+     .mapSwappable    = &smmglru_mapSwappable,
+     .setUnswappable  = &smmglru_setUnswappable,
+     .swapOut         = &smmglru_swapOut,
+     
+     .check           = &smmglru_check
+};
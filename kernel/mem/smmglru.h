@@ -0,0 +1,13 @@
+#ifndef _KERNEL_MEM_SMMGLRU_H_
+#define _KERNEL_MEM_SMMGLRU_H_
+
+/* swap manager using generations aged by page table walks(multi-generational lru) */
+
+#include "mem/swap.h"
+
+// generations kept at most, the two oldest are merged to make a new one
+#define SMMGLRU_NGEN 4
+
+extern swap_manager_t swap_manager_mglru;
+
+#endif
@@ -1,21 +1,29 @@
 #include "pub/com.h"
+#include "pub/error.h"
+#include "pub/string.h"
 
 #include "lib/debug.h"
 #include "fs/swapfs.h"
+#include "driver/clock.h"
+#include "driver/blk.h"
 
 #include "mem/swap.h"
 #include "mem/smfifo.h"
+#include "mem/smclock.h"
+#include "mem/smarc.h"
+#include "mem/smmglru.h"
+#include "mem/swapcache.h"
+#include "mem/swapslot.h"
+#include "mem/swapzpool.h"
 #include "mem/pmm.h"
 #include "mem/vmm.h"
 
-static size_t max_swap_offset;
-
 size_t swap_getOffset(swap_entry_t entry)
 {
-    size_t offset = entry >> 8;
+    size_t offset = SWAP_OFFSET(entry);
     
-    if (!offset || offset >= max_swap_offset) {
-        panic("invalid swap_entry_t = %08x", entry);
+    if (!swap_slotIsValid(offset)) {
+        panic("invalid swap_entry_t = %08llx", (uint64_t)entry);
     }
     
     return offset;
@@ -33,7 +41,7 @@ size_t swap_getOffset(swap_entry_t entry)
 // the max access seq number
 #define MAX_SEQ_NO 10
 
-static swap_manager_t *swap_man = &swap_manager_fifo;
+static swap_manager_t *swap_man = &swap_manager_clock;
 
 bool swap_init_ok = 0;
 
@@ -45,25 +53,39 @@ static void check_swap();
 
 int swap_init()
 {
-    max_swap_offset = swapfs_init();
+    size_t narea = swapfs_init(), nslot[SWAP_MAX_TYPE], type;
+    int prio[SWAP_MAX_TYPE];
 
-    if (max_swap_offset == 0) {
+    if (narea == 0) {
         trace("swap diabled");
         swap_disable();
         return 0;
     }
-
-    if (!(1024 <= max_swap_offset && max_swap_offset < SWAP_MAX_OFFSET_LIMIT)) {
-        panic("bad max_swap_offset %08x", max_swap_offset);
+    
+    for (type = 0; type < narea; type++) {
+        nslot[type] = swapfs_areaNSlot(type);
+        prio[type] = swapfs_areaPrio(type);
+    }
+    
+    int r;
+    
+    if ((r = swap_slotInit(nslot, prio, narea))) {
+        trace("swap: no memory for the slot map");
+        swap_disable();
+        return r;
     }
 
     // swap_man = &swap_manager_fifo;
-    int r = swap_man->init();
+    r = swap_man->init();
 
     if (r == 0) {
         swap_enable();
         trace("swap: init manager = %s", swap_man->name);
         
+        if (swap_zpoolInit(swap_slotNIndex())) {
+            trace("swap: no memory for the compressed pool");
+        }
+        
         check_swap();
     }
 
@@ -76,6 +98,11 @@ int swap_initVMASet(vma_set_t *set)
     return swap_man->initVMASet(set);
 }
 
+int swap_exitVMASet(vma_set_t *set)
+{
+    return swap_man->exitVMASet(set);
+}
+
 int swap_tick(vma_set_t *set)
 {
     return swap_man->tick(set);
@@ -83,19 +110,295 @@ int swap_tick(vma_set_t *set)
 
 int swap_mapSwappable(vma_set_t *set, uintptr_t addr, page_t *page, int swap_in)
 {
+    page_setSwap(page);
     return swap_man->mapSwappable(set, addr, page, swap_in);
 }
 
+// take the page mapped at addr away from the swap manager(if it's there)
 int swap_setUnswappable(vma_set_t *set, uintptr_t addr)
 {
+    page_t *page = get_page(set->pgdir, addr, NULL);
+    
+    if (!page || !page_isSwap(page)) {
+        return 0;
+    }
+    
+    page_resetSwap(page);
+    
     return swap_man->setUnswappable(set, addr);
 }
 
+// swap_clearRef - clear the accessed bit of page, for swap managers
+// return value: whether it was set
+bool swap_clearRef(vma_set_t *set, page_t *page, swap_flush_t *flush)
+{
+    pte_t *ptep = get_pte(set->pgdir, page->pra_vaddr, 0);
+    
+    assert(ptep && (*ptep & PTE_FLAG_P));
+    
+    return swap_clearPteRef(ptep, page->pra_vaddr, flush);
+}
+
+// swap_clearPteRef - clear the accessed bit of *ptep mapping addr,
+//                  - for swap managers walking page tables themselves
+// return value: whether it was set
+bool swap_clearPteRef(pte_t *ptep, uintptr_t addr, swap_flush_t *flush)
+{
+    if (!(*ptep & PTE_FLAG_A)) {
+        return 0;
+    }
+    
+    *ptep &= ~PTE_FLAG_A;
+    
+    // the tlb has to forget the bit, or it won't be set again
+    if (flush->n < SWAP_FLUSH_BATCH) {
+        flush->addr[flush->n] = addr;
+    }
+    
+    flush->n++;
+    
+    return 1;
+}
+
+void swap_flush(vma_set_t *set, swap_flush_t *flush)
+{
+    size_t i;
+    
+    if (flush->n > SWAP_FLUSH_BATCH) {
+        tlb_flush();
+    } else {
+        for (i = 0; i < flush->n; i++) {
+            tlb_invalidate(set->pgdir, flush->addr[i]);
+        }
+    }
+    
+    flush->n = 0;
+}
+
+// swap_pickSet - choose the vma set to reclaim pages from
+// return value: the set furthest over its rss limit, or if no one is over,
+//               the one with the most pages for its recent faults(big and
+//               idle sets go first), NULL if nothing can be swapped out
+vma_set_t *swap_pickSet()
+{
+    vma_set_t *set, *best = NULL;
+    size_t best_over = 0, best_score = 0, over, score;
+    
+    for (set = vma_set_next(NULL); set; set = vma_set_next(set)) {
+        if (!set->swap_data || !set->pgdir || !set->nresident) continue;
+        
+        over = 0;
+        
+        if (set->rss_limit && set->nresident > set->rss_limit) {
+            over = set->nresident - set->rss_limit;
+        }
+        
+        score = set->nresident * SWAP_ACTIVE_WEIGHT / (set->nactive + SWAP_ACTIVE_WEIGHT);
+        
+        if (!best || over > best_over ||
+            (over == best_over && score > best_score) ||
+            (over == best_over && score == best_score && set->nresident > best->nresident)) {
+            best = set;
+            best_over = over;
+            best_score = score;
+        }
+    }
+    
+    return best;
+}
+
 volatile unsigned int swap_out_num = 0;
 
-int swap_out(vma_set_t *set, int n, int in_tick)
+// swap traffic since boot, see swap_dumpStat
+static swap_stat_t swap_stat;
+
+// victims written together in one command
+#define SWAP_CLUSTER_NPAGE SWAPFS_MAX_NPAGE
+
+// swap_park - the contents of page are in entry, unmap it
+static void swap_park(vma_set_t *set, page_t *page, swap_entry_t entry)
 {
-    int i;
+    pte_t *ptep = get_pte(set->pgdir, page->pra_vaddr, 0);
+    
+    *ptep = entry;
+    tlb_invalidate(set->pgdir, page->pra_vaddr);
+    
+    // freed when memory runs out, see palloc
+    swap_cachePark(page);
+    
+    assert(set->nresident);
+    set->nresident--;
+    set->nswapped++;
+}
+
+// victims gathered for slots start, start + 1, ... and their write
+typedef struct {
+    page_t *pages[SWAP_CLUSTER_NPAGE];
+    size_t n, start;
+    swapfs_io_t io;
+} swap_cluster_t;
+
+// clusters written while the next ones are gathered, the block queue is
+// plugged meanwhile so it gets to merge and order them
+#define SWAP_BATCH_NCLUSTER 2
+
+// swap_endCluster - wait for the write of cluster, then park its victims
+// return value: # of pages swapped out
+static int swap_endCluster(vma_set_t *set, swap_cluster_t *cluster)
+{
+    size_t i, n = cluster->n, start = cluster->start;
+    
+    if (swapfs_wait(&cluster->io)) {
+        trace("swap: failed to save %d victims", n);
+        swap_stat.nfail++;
+        
+        for (i = 0; i < n; i++) {
+            swap_slotFree(start + i);
+            swap_mapSwappable(set, cluster->pages[i]->pra_vaddr, cluster->pages[i], 0); // swap back???
+        }
+        
+        return 0;
+    }
+    
+    trace("swap: store %d pages to disk swap entry %d~%d", n, start, start + n - 1);
+    
+    swap_stat.nwrite += n;
+    swap_stat.ncluster++;
+    
+    for (i = 0; i < n; i++) {
+        swap_cacheAdd(cluster->pages[i], SWAP_ENTRY(start + i));
+        swap_park(set, cluster->pages[i], SWAP_ENTRY(start + i));
+    }
+    
+    return n;
+}
+
+// swap_endBatch - unplug the block queue and end the clusters written
+// return value: # of pages swapped out
+static int swap_endBatch(vma_set_t *set, swap_cluster_t *batch, size_t *nbatch)
+{
+    int nout = 0;
+    size_t i;
+    
+    blk_unplug();
+    
+    for (i = 0; i < *nbatch; i++) {
+        nout += swap_endCluster(set, &batch[i]);
+    }
+    
+    *nbatch = 0;
+    batch[0].n = batch[0].start = 0;
+    
+    return nout;
+}
+
+// swap_writeCluster - start writing the cluster being gathered,
+//                   - batch[*nbatch]. the batch is ended once it's full
+// return value: # of pages swapped out
+static int swap_writeCluster(vma_set_t *set, swap_cluster_t *batch, size_t *nbatch)
+{
+    swap_cluster_t *cluster = &batch[*nbatch];
+    int nout = 0;
+    
+    if (!cluster->n) {
+        return 0;
+    }
+    
+    swapfs_start(&cluster->io, SWAP_ENTRY(cluster->start), cluster->pages, cluster->n, 1);
+    
+    if (++*nbatch == SWAP_BATCH_NCLUSTER) {
+        nout = swap_endBatch(set, batch, nbatch);
+        blk_plug();
+    }
+    
+    batch[*nbatch].n = batch[*nbatch].start = 0;
+    
+    return nout;
+}
+
+// swap_isZero - whether page holds only zeros, the words of a cache line
+//             - are or-ed together so that most pages stop at the first line
+static bool swap_isZero(page_t *page)
+{
+    uint32_t *kva = kmap(page), *p, *end = kva + PAGE_SIZE / sizeof(uint32_t);
+    bool zero = 1;
+    
+    for (p = kva; p < end; p += 8) {
+        if (p[0] | p[1] | p[2] | p[3] | p[4] | p[5] | p[6] | p[7]) {
+            zero = 0;
+            break;
+        }
+    }
+    
+    kunmap(kva);
+    
+    return zero;
+}
+
+// swap_dropZero - a victim holds only zeros, unmap it and free its frame,
+//               - see swap_inZero
+static void swap_dropZero(vma_set_t *set, page_t *page)
+{
+    pte_t *ptep = get_pte(set->pgdir, page->pra_vaddr, 0);
+    
+    trace("swap: page in vaddr 0x%x is zero", page->pra_vaddr);
+    
+    *ptep = SWAP_ZERO_ENTRY;
+    tlb_invalidate(set->pgdir, page->pra_vaddr);
+    
+    page_clearRef(page);
+    pfree(page);
+    
+    swap_stat.nzero++;
+    
+    assert(set->nresident);
+    set->nresident--;
+    set->nswapped++;
+}
+
+// swap_compress - keep a victim compressed in memory instead of on disk
+// return value: true if it's stored and unmapped
+static bool swap_compress(vma_set_t *set, page_t *page)
+{
+    size_t offset;
+    
+    if (!swap_zpoolIsOn() || !swap_slotAlloc(1, &offset)) {
+        return 0;
+    }
+    
+    if (swap_zpoolStore(offset, page)) {
+        swap_slotFree(offset);
+        return 0;
+    }
+    
+    trace("swap: compress page in vaddr 0x%x to swap entry %d", page->pra_vaddr, offset);
+    
+    swap_cacheAdd(page, SWAP_ENTRY(offset));
+    swap_park(set, page, SWAP_ENTRY(offset));
+    
+    return 1;
+}
+
+// swap_evict - evict n pages of set, dirty ones are gathered and written
+//            - to consecutive slots with as few commands as possible
+// parameters:
+//  victims: the pages to evict, already taken from the swap manager,
+//           NULL to let the swap manager choose
+// return value: # of pages swapped out
+static int swap_evict(vma_set_t *set, int n, page_t **victims, int in_tick)
+{
+    int i, r, nout = 0;
+    
+    // slots allocated but not used yet, so that pages written
+    // one after another land next to each other
+    size_t run = 0, nrun = 0;
+    
+    // clusters being written, then the one being gathered
+    swap_cluster_t batch[SWAP_BATCH_NCLUSTER], *cluster;
+    size_t nbatch = 0;
+    
+    batch[0].n = batch[0].start = 0;
+    blk_plug();
 
     for (i = 0; i != n; i++) {
         uintptr_t v;
@@ -105,14 +408,22 @@ int swap_out(vma_set_t *set, int n, int in_tick)
 
         trace("swap: call swap_out_victim, i %d", i);
 
-        int r = swap_man->swapOut(set, &page, in_tick);
+        if (victims) {
+            page = victims[i];
+            r = 0;
+        } else {
+            r = swap_man->swapOut(set, &page, in_tick);
+            swap_stat.nscan++;
+        }
 
         if (r) {
             trace("swap: call swap_out_victim failed, i %d", i);
+            swap_stat.nfail++;
             break;
         }
         
         assert(!page_isReserved(page));
+        page_resetSwap(page);
 
         trace("swap: choose victim page 0x%08x", page);
 
@@ -120,42 +431,498 @@ int swap_out(vma_set_t *set, int n, int in_tick)
         
         pte_t *ptep = get_pte(set->pgdir, v, 0);
         assert(*ptep & PTE_FLAG_P); // table present
-
-        // TODO: what does swap entry mean
-        if (swapfs_write((page->pra_vaddr / PAGE_SIZE + 1) << 8, page)) {
-            trace("swap: failed to save victim");
-            swap_man->mapSwappable(set, v, page, 0); // swap back???
+        
+        if (page_isCached(page) && !(*ptep & PTE_FLAG_D)) {
+            // the slot still has the same contents
+            trace("swap: i %d, page in vaddr 0x%x is clean in swap entry %d",
+                  i, v, SWAP_OFFSET(page->swap_entry));
+            
+            swap_stat.nclean++;
+            swap_park(set, page, page->swap_entry);
+            nout++;
+            
             continue;
-        } else {
-            trace("swap: i %d, store page in vaddr 0x%x to disk swap entry %d",
-                  i, v, page->pra_vaddr / PAGE_SIZE + 1);
-                  
-            *ptep = (page->pra_vaddr / PAGE_SIZE + 1) << 8;
+        }
+        
+        if (page_isCached(page)) {
+            // the old copy is useless, write to a new slot with the others
+            swap_cacheDrop(page);
+        }
+        
+        if (swap_isZero(page)) {
+            swap_dropZero(set, page);
+            nout++;
+            continue;
+        }
+    
+        // only pages that don't compress well need i/o
+        if (swap_compress(set, page)) {
+            nout++;
+            continue;
+        }
+        
+        if (!nrun) {
+            size_t want = n - i;
+            
+            if (want > SWAP_CLUSTER_NPAGE) {
+                want = SWAP_CLUSTER_NPAGE;
+            }
             
-            pfree(page);
+            if (!(nrun = swap_slotAlloc(want, &run))) {
+                trace("swap: out of swap slots");
+                swap_stat.nfail++;
+                swap_mapSwappable(set, v, page, 0);
+                break;
+            }
+            
+            if (run != batch[nbatch].start + batch[nbatch].n) {
+                // not next to the cluster, it cannot grow any more
+                nout += swap_writeCluster(set, batch, &nbatch);
+            }
+        }
+        
+        cluster = &batch[nbatch];
+        
+        if (!cluster->n) {
+            cluster->start = run;
+        }
+        
+        cluster->pages[cluster->n++] = page;
+        run++;
+        nrun--;
+        
+        if (cluster->n == SWAP_CLUSTER_NPAGE) {
+            nout += swap_writeCluster(set, batch, &nbatch);
         }
+    }
+    
+    // given victims not reached stay mapped, back to the swap manager
+    for (i++; victims && i < n; i++) {
+        swap_mapSwappable(set, victims[i]->pra_vaddr, victims[i], 0);
+    }
+    
+    nout += swap_writeCluster(set, batch, &nbatch);
+    nout += swap_endBatch(set, batch, &nbatch);
+    
+    for (; nrun; nrun--, run++) {
+        swap_slotFree(run);
+    }
+    
+    if (in_tick) {
+        swap_stat.nbg++;
+        swap_stat.nbgout += nout;
+    } else {
+        swap_stat.ndirect++;
+        swap_stat.nsyncout += nout;
+    }
 
-        tlb_invalidate(set->pgdir, v);
+    return nout;
+}
+
+// swap_out - evict n pages of set chosen by the swap manager
+// return value: # of pages swapped out
+int swap_out(vma_set_t *set, int n, int in_tick)
+{
+    return swap_evict(set, n, NULL, in_tick);
+}
+
+// swap_outPages - evict the given mapped pages of set, for palloc_reclaim
+// return value: # of pages swapped out
+int swap_outPages(vma_set_t *set, page_t **pages, int n)
+{
+    int i, nout;
+    
+    for (i = 0; i < n; i++) {
+        swap_setUnswappable(set, pages[i]->pra_vaddr);
     }
+    
+    nout = swap_evict(set, n, pages, 0);
+    swap_stat.nrange += nout;
+    
+    return nout;
+}
 
-    return i;
+// swap_pageOwner - find the vma set a swappable page is mapped in
+// return value: the set, NULL if there is none
+vma_set_t *swap_pageOwner(page_t *page)
+{
+    vma_set_t *set;
+    pte_t *ptep;
+    
+    for (set = vma_set_next(NULL); set; set = vma_set_next(set)) {
+        if (!set->swap_data || !set->pgdir) continue;
+        
+        ptep = get_pte(set->pgdir, page->pra_vaddr, 0);
+        
+        if (ptep && (*ptep & PTE_FLAG_P) && pte2page(*ptep) == page) {
+            return set;
+        }
+    }
+    
+    return NULL;
 }
 
-int swap_in(vma_set_t *set, uintptr_t addr, page_t **presult)
+// free memory kept by background reclaim
+#define SWAP_FREE_LOW   (c0re_npage / 128)  // free pages
+#define SWAP_FREE_HIGH  (c0re_npage / 64)   // free and parked pages
+
+static volatile bool swap_reclaimPending = 0;
+
+// swap_reclaim - write victims ahead of time until free and parked pages
+//              - reach high, then free parked ones until low pages are free
+// return value: # of pages written
+static size_t swap_reclaim(size_t low, size_t high)
+{
+    size_t nfree = nfpage(), nout = 0, n;
+    vma_set_t *set;
+    
+    // parked pages are freed by allocations without i/o
+    if (nfree + swap_cacheNParked() < high && (set = swap_pickSet())) {
+        n = high - nfree - swap_cacheNParked();
+        nout = swap_out(set, n < SWAP_RECLAIM_BATCH ? n : SWAP_RECLAIM_BATCH, 1);
+    }
+    
+    if ((nfree = nfpage()) < low) {
+        swap_cacheShrink(low - nfree);
+    }
+    
+    return nout;
+}
+
+// swap_timer - called from the timer interrupt, the work is deferred
+//            - to swap_reclaimd since a page table may be half-updated
+void swap_timer()
+{
+    if (swap_hasInit() && clock_tick() % SWAP_RECLAIM_INTERVAL == 0) {
+        swap_reclaimPending = 1;
+    }
+}
+
+// swap_reclaimd - background reclaim, called from the idle loop
+//               - does nothing unless swap_timer asked for it
+// return value: # of pages written
+size_t swap_reclaimd()
+{
+    vma_set_t *set;
+    
+    if (!swap_reclaimPending) {
+        return 0;
+    }
+    
+    swap_reclaimPending = 0;
+    
+    // so that victims are found with short sweeps
+    for (set = vma_set_next(NULL); set; set = vma_set_next(set)) {
+        if (set->swap_data) {
+            swap_tick(set);
+        }
+        
+        // old faults count less and less in swap_pickSet
+        set->nactive /= 2;
+    }
+    
+    return swap_reclaim(SWAP_FREE_LOW, SWAP_FREE_HIGH);
+}
+
+// swap_free - a pte holding entry is cleared, give back its slot
+//           - and the page parked for it
+void swap_free(swap_entry_t entry)
+{
+    page_t *page;
+    
+    if (entry == SWAP_ZERO_ENTRY) {
+        return;
+    }
+    
+    if ((page = swap_cacheTake(entry))) {
+        swap_cacheDrop(page);
+        pfree(page);
+    } else {
+        swap_zpoolFree(swap_getOffset(entry));
+        swap_slotFree(swap_getOffset(entry));
+    }
+}
+
+void swap_resetStat()
+{
+    no_intr_block(memset(&swap_stat, 0, sizeof(swap_stat)));
+    swapfs_resetStat();
+}
+
+// swap_dumpStat - print swap space usage, traffic and reclaim counters
+void swap_dumpStat()
+{
+    swap_zpool_stat_t zpool;
+    size_t nslot = swap_slotNSlot(), nused = nslot - swap_slotNFree();
+    vma_set_t *set;
+    
+    kprintf("swap: %s, %s\n", swap_hasInit() ? "enabled" : "disabled", swap_man->name);
+    kprintf(DBG_TAB "slots used %u of %u(%u KB), free pages %u, parked %u\n",
+            nused, nslot, nused * (PAGE_SIZE / 1024), nfpage(), swap_cacheNParked());
+    kprintf(DBG_TAB "in %u, minor %u, read %u, read ahead %u, hits %u\n",
+            swap_stat.nin, swap_stat.nminor, swap_stat.nread, swap_stat.nra, swap_stat.nrahit);
+    kprintf(DBG_TAB "out %u(direct %u, background %u), written %u in %u commands, clean %u\n",
+            swap_stat.nsyncout + swap_stat.nbgout, swap_stat.nsyncout, swap_stat.nbgout,
+            swap_stat.nwrite, swap_stat.ncluster, swap_stat.nclean);
+    kprintf(DBG_TAB "zero pages: out %u, in %u\n", swap_stat.nzero, swap_stat.nzeroin);
+    kprintf(DBG_TAB "reclaim runs: direct %u, background %u, victims %u, failures %u\n",
+            swap_stat.ndirect, swap_stat.nbg, swap_stat.nscan, swap_stat.nfail);
+    kprintf(DBG_TAB "pages evicted for multi-page allocations %u\n", swap_stat.nrange);
+    
+    // the manager's own view of each set
+    for (set = vma_set_next(NULL); set && swap_man->dumpStat; set = vma_set_next(set)) {
+        if (set->swap_data) {
+            swap_man->dumpStat(set);
+        }
+    }
+    
+    if (swap_zpoolIsOn()) {
+        swap_zpoolGetStat(&zpool);
+        
+        kprintf(DBG_TAB "pool: %u pages hold %u(%u bytes), stored %u, rejected %u, "
+                "full %u, loaded %u, written back %u\n",
+                zpool.npage, zpool.nobj, zpool.nbytes, zpool.nstore, zpool.nreject,
+                zpool.nfull, zpool.nload, zpool.nwriteback);
+    }
+    
+    swapfs_dumpStat();
+}
+
+// a header every this many samples
+#define SWAP_SAMPLE_NLINE 20
+
+static size_t swap_sampleInterval = 0;  // ticks between two samples, 0 for none
+static long swap_sampleNext = 0;
+static size_t swap_sampleCount = 0;
+static swap_stat_t swap_sampleLast;
+
+// swap_setSampleInterval - print a line of counters every ticks ticks, 0 to stop
+void swap_setSampleInterval(size_t ticks)
+{
+    swap_sampleLast = swap_stat;
+    swap_sampleCount = 0;
+    swap_sampleNext = clock_tick() + ticks;
+    swap_sampleInterval = ticks;
+}
+
+// swap_sample - called from the idle loop, prints what happened since the
+//             - last sample once the interval is over, like vmstat
+void swap_sample()
+{
+    swap_stat_t now = swap_stat, *last = &swap_sampleLast;
+    
+    if (!swap_sampleInterval || clock_tick() < swap_sampleNext) {
+        return;
+    }
+    
+    swap_sampleNext = clock_tick() + swap_sampleInterval;
+    
+    if (swap_sampleCount++ % SWAP_SAMPLE_NLINE == 0) {
+        kprintf("%7s %6s %7s %6s %6s %6s %6s %6s %6s %6s %5s\n", "free", "parked", "swpd",
+                "in", "minor", "out", "bgout", "write", "direct", "bg", "fail");
+    }
+    
+    kprintf("%7u %6u %7u %6u %6u %6u %6u %6u %6u %6u %5u\n",
+            nfpage(), swap_cacheNParked(), swap_slotNSlot() - swap_slotNFree(),
+            now.nin - last->nin, now.nminor - last->nminor,
+            now.nsyncout + now.nbgout - last->nsyncout - last->nbgout,
+            now.nbgout - last->nbgout, now.nwrite - last->nwrite,
+            now.ndirect - last->ndirect, now.nbg - last->nbg, now.nfail - last->nfail);
+    
+    *last = now;
+}
+
+// readahead, see swap_raPrepare
+#define SWAP_RA_MIN     2  // window never shrinks below this
+#define SWAP_RA_MAX     8  // pages read in one command at most
+#define SWAP_RA_SAMPLE  16 // pages read ahead before the window is adjusted
+
+static size_t swap_raWindow = SWAP_RA_MAX / 2;
+
+// since the window was adjusted
+static size_t swap_raIssued = 0, swap_raHit = 0;
+
+// swap_raPrepare - find the pages to read together with the one at addr
+//                - the next pages of the vma are taken as long as they are
+//                - in the next slots, so the window is a single command
+// parameters:
+//  pages: free pages to read them into are stored here
+// return value: # of pages to read ahead
+static size_t swap_raPrepare(vma_set_t *set, uintptr_t addr, swap_entry_t entry, page_t **pages)
 {
-     page_t *result = palloc_s(1);
+    vma_t *vma = vma_set_find(set, addr);
+    size_t offset = SWAP_OFFSET(entry), n;
+    
+    // the slots are better given back than kept for readahead
+    if (!vma || swap_slotIsScarce()) {
+        return 0;
+    }
+    
+    for (n = 0; n + 1 < swap_raWindow; n++) {
+        uintptr_t next = addr + (n + 1) * PAGE_SIZE;
+        
+        if (next <= addr || next >= vma->end) {
+            break;
+        }
+        
+        pte_t *ptep = get_pte(set->pgdir, next, 0);
+        
+        if (!ptep || *ptep != SWAP_ENTRY(offset + n + 1) ||
+            SWAP_TYPE(offset + n + 1) != SWAP_TYPE(offset) ||
+            swap_cacheLookup(*ptep) || swap_zpoolHas(offset + n + 1)) {
+            break;
+        }
+        
+        // never reclaim for readahead
+        if (!(pages[n] = palloc_try())) {
+            break;
+        }
+    }
+    
+    return n;
+}
 
+// swap_raAdjust - n pages are read ahead, resize the window once in
+//               - a while: halve it if most of them are wasted, double it
+//               - if most of them are used
+static void swap_raAdjust(size_t n)
+{
+    swap_stat.nra += n;
+    swap_raIssued += n;
+    
+    if (swap_raIssued < SWAP_RA_SAMPLE) {
+        return;
+    }
+    
+    if (swap_raHit * 2 < swap_raIssued) {
+        swap_raWindow = swap_raWindow / 2 < SWAP_RA_MIN ? SWAP_RA_MIN : swap_raWindow / 2;
+    } else if (swap_raHit * 4 >= swap_raIssued * 3) {
+        swap_raWindow = swap_raWindow * 2 > SWAP_RA_MAX ? SWAP_RA_MAX : swap_raWindow * 2;
+    }
+    
+    trace("swap: readahead %d hits of %d, window %d", swap_raHit, swap_raIssued, swap_raWindow);
+    
+    swap_raIssued = swap_raHit = 0;
+}
+
+// swap_inZero - a page of zeros is faulted on, a zeroed frame will do
+static int swap_inZero(vma_set_t *set, page_t **presult)
+{
+    page_t *page = palloc_high();
+    
+    if (!page) {
+        trace("swap: no page for a zero page");
+        swap_stat.nfail++;
+        return -E_NO_MEM;
+    }
+    
+    void *kva = kmap(page);
+    memset(kva, 0, PAGE_SIZE);
+    kunmap(kva);
+    
+    swap_stat.nzeroin++;
+    *presult = page;
+    
+    assert(set->nswapped);
+    set->nswapped--;
+    
+    return 0;
+}
+
+int swap_in(vma_set_t *set, uintptr_t addr, page_t **presult)
+{
      pte_t *ptep = get_pte(set->pgdir, addr, 0);
+    
+     if (*ptep == SWAP_ZERO_ENTRY) {
+        return swap_inZero(set, presult);
+     }
+    
+     page_t *result = swap_cacheTake(*ptep);
+     
+     if (result) {
+        trace("swap: take swap entry %d from the swap cache", SWAP_OFFSET(*ptep));
+        
+        if (page_isReadahead(result)) {
+            page_resetReadahead(result);
+            swap_stat.nrahit++;
+            swap_raHit++;
+        }
+        
+        swap_stat.nminor++;
+        *presult = result;
+        
+        assert(set->nswapped);
+        set->nswapped--;
+        
+        return 0;
+     }
+     
+     // the faulting page first, then the ones read ahead
+     page_t *pages[SWAP_RA_MAX];
+     size_t nra, i;
+     
+     result = palloc_high();
+     
+     if (!result) {
+        trace("swap: no page to swap in");
+        swap_stat.nfail++;
+        return -E_NO_MEM;
+     }
+     
+     pages[0] = result;
+     nra = 0;
+
      // cprintf("SWAP: load ptep %x swap entry %d to vaddr 0x%08x, page %x, No %d\n", ptep, (*ptep)>>8, addr, result, (result-pages));
     
      int r;
-     if ((r = swapfs_read((*ptep), result))) {
-        trace("swap: failed to swap in"); // TODO: ???
+     if (!(r = swap_zpoolLoad(swap_getOffset(*ptep), result))) {
+        trace("swap: decompress swap entry %d from the pool", SWAP_OFFSET(*ptep));
+     } else {
+        nra = swap_raPrepare(set, addr, *ptep, pages + 1);
+        
+        if ((r = swapfs_readv((*ptep), pages, nra + 1))) {
+            // the pte and the slot stay as they are, the fault fails
+            trace("swap: failed to swap in swap entry %d, error %e", SWAP_OFFSET(*ptep), r);
+            
+            for (i = 0; i <= nra; i++) {
+                pfree(pages[i]);
+            }
+            
+            swap_stat.nfail++;
+            return r;
+        }
+        
+        swap_stat.nread += nra + 1;
+     }
+     
+     swap_stat.nin++;
+     
+     if (swap_slotIsScarce()) {
+        swap_zpoolFree(swap_getOffset(*ptep));
+        swap_slotFree(swap_getOffset(*ptep));
+     } else {
+        // the slot stays valid while the page is clean
+        swap_cacheAdd(result, *ptep);
+     }
+     
+     // the slots still belong to their ptes
+     for (i = 1; i <= nra; i++) {
+        swap_cacheAdd(pages[i], SWAP_ENTRY(SWAP_OFFSET(*ptep) + i));
+        swap_cachePark(pages[i]);
+        page_setReadahead(pages[i]);
      }
      
-     trace("swap: load disk swap entry %d with swap_page in vadr 0x%x", (*ptep) >> 8, addr);
+     if (nra) {
+        swap_raAdjust(nra);
+     }
+     
+     trace("swap: load disk swap entry %d with swap_page in vadr 0x%x, %d read ahead",
+           SWAP_OFFSET(*ptep), addr, nra);
      *presult = result;
      
+     assert(set->nswapped);
+     set->nswapped--;
+     
      return 0;
 }
 
@@ -195,16 +962,297 @@ int check_content_access()
     return swap_man->check();
 }
 
+C0RE_INLINE
+void check_touch(size_t n)
+{
+    *(unsigned char *)(n * PAGE_SIZE) = n;
+}
+
+// loop over one more page than there are frames
+// return value: # of page faults
+static int check_trace_loop()
+{
+    size_t init = vmm_getPageFaultCount();
+    int i;
+    
+    for (i = 0; i < 3 * CHECK_VALID_VIR_PAGE_NUM; i++) {
+        check_touch(i % CHECK_VALID_VIR_PAGE_NUM + 1);
+    }
+    
+    return vmm_getPageFaultCount() - init;
+}
+
+// one hot page touched between every two cold ones
+// return value: # of page faults
+static int check_trace_skewed()
+{
+    size_t init = vmm_getPageFaultCount();
+    int i;
+    
+    for (i = 0; i < 4 * (CHECK_VALID_VIR_PAGE_NUM - 1); i++) {
+        check_touch(1);
+        check_touch(i % (CHECK_VALID_VIR_PAGE_NUM - 1) + 2);
+    }
+    
+    return vmm_getPageFaultCount() - init;
+}
+
+// two hot pages reused between scans through the cold ones
+// return value: # of page faults
+static int check_trace_scan()
+{
+    size_t init = vmm_getPageFaultCount();
+    int i, j;
+    
+    for (i = 0; i < 4; i++) {
+        check_touch(1);
+        check_touch(2);
+        check_touch(1);
+        check_touch(2);
+    
+        for (j = 3; j <= CHECK_VALID_VIR_PAGE_NUM; j++) {
+            check_touch(j);
+        }
+    }
+    
+    return vmm_getPageFaultCount() - init;
+}
+
+// read-only loop, pages swapped in are clean and never written again
+// return value: # of pages written
+static int check_trace_readLoop()
+{
+    size_t nwrite = swap_stat.nwrite, nclean = swap_stat.nclean;
+    int i;
+    
+    for (i = 0; i < 3 * CHECK_VALID_VIR_PAGE_NUM; i++) {
+        (void)*(volatile unsigned char *)((i % CHECK_VALID_VIR_PAGE_NUM + 1) * PAGE_SIZE);
+    }
+    
+    assert(swap_stat.nclean > nclean);
+    
+    return swap_stat.nwrite - nwrite;
+}
+
+// pages evicted for the rss limit are parked, faults on them need no i/o
+static int check_trace_minor()
+{
+    extern vma_set_t *c0re_check_vma_set;
+    vma_set_t *set = c0re_check_vma_set;
+    
+    size_t nminor = swap_stat.nminor, nwrite = swap_stat.nwrite, ncluster = swap_stat.ncluster, i;
+    pte_t *ptep;
+    
+    // two pages are evicted, one of them is reused right away
+    vma_set_setRSSLimit(set, CHECK_VALID_PHY_PAGE_NUM - 1);
+    check_touch(CHECK_VALID_VIR_PAGE_NUM);
+    
+    assert(swap_cacheNParked() == 1);
+    
+    for (i = 1; i < CHECK_VALID_VIR_PAGE_NUM; i++) {
+        ptep = get_pte(set->pgdir, i * PAGE_SIZE, 0);
+        
+        if (!(*ptep & PTE_FLAG_P) && swap_cacheLookup(*ptep)) {
+            break;
+        }
+    }
+    
+    assert(i < CHECK_VALID_VIR_PAGE_NUM);
+    // one more is evicted to stay in the limit
+    assert(*(unsigned char *)(i * PAGE_SIZE) == 0x0a + i - 1);
+    
+    assert(swap_stat.nminor == nminor + 1);
+    assert(swap_stat.nwrite == nwrite + 3); // all of them were dirty
+    assert(swap_stat.ncluster == ncluster + 2); // the first two went together
+    
+    vma_set_setRSSLimit(set, 0);
+    
+    return 0;
+}
+
+// a page next to the faulting one in memory and on disk is read with it
+static int check_trace_readahead()
+{
+    extern vma_set_t *c0re_check_vma_set;
+    vma_set_t *set = c0re_check_vma_set;
+    
+    size_t nra = swap_stat.nra, nrahit = swap_stat.nrahit, i;
+    pte_t *ptep = get_pte(set->pgdir, PAGE_SIZE, 0);
+    pte_t *next = get_pte(set->pgdir, 2 * PAGE_SIZE, 0);
+    page_t *pages[2];
+    
+    // two dirty neighbours evicted together are written to neighbouring slots
+    *(unsigned char *)PAGE_SIZE = 0x0a;
+    *(unsigned char *)(2 * PAGE_SIZE) = 0x0b;
+    
+    for (i = 0; i < 2; i++) {
+        pages[i] = get_page(set->pgdir, (i + 1) * PAGE_SIZE, NULL);
+    }
+    
+    assert(swap_outPages(set, pages, 2) == 2);
+    assert(*next == SWAP_ENTRY(SWAP_OFFSET(*ptep) + 1));
+    
+    // free their frames, so that the fault needs i/o and there is room to read ahead
+    swap_cacheShrink(swap_cacheNParked());
+    
+    assert(*(unsigned char *)PAGE_SIZE == 0x0a);
+    assert(swap_stat.nra == nra + 1 && swap_cacheLookup(*next));
+    
+    assert(*(unsigned char *)(2 * PAGE_SIZE) == 0x0b);
+    assert(swap_stat.nrahit == nrahit + 1);
+    
+    // use up the frames again
+    for (i = 1; i <= CHECK_VALID_VIR_PAGE_NUM; i++) {
+        (void)*(volatile unsigned char *)(i * PAGE_SIZE);
+    }
+    
+    return 0;
+}
+
+// a page of zeros takes no slot and no i/o either way
+static int check_trace_zero()
+{
+    extern vma_set_t *c0re_check_vma_set;
+    vma_set_t *set = c0re_check_vma_set;
+    
+    size_t nzero = swap_stat.nzero, nzeroin = swap_stat.nzeroin;
+    size_t nread = swap_stat.nread, nslot = swap_slotNFree();
+    pte_t *ptep = get_pte(set->pgdir, PAGE_SIZE, 0);
+    
+    // frames aren't cleared when they're mapped, and the page was written
+    memset((void *)PAGE_SIZE, 0, PAGE_SIZE);
+    
+    swap_out(set, set->nresident, 0);
+    
+    assert(*ptep == SWAP_ZERO_ENTRY && swap_stat.nzero == nzero + 1);
+    assert(nfpage() == 1 && swap_slotNFree() == nslot - (CHECK_VALID_PHY_PAGE_NUM - 1));
+    
+    assert(*(unsigned char *)PAGE_SIZE == 0);
+    assert(*(unsigned char *)(PAGE_SIZE + PAGE_SIZE - 1) == 0);
+    assert(swap_stat.nzeroin == nzeroin + 1 && swap_stat.nread == nread);
+    
+    return 0;
+}
+
+// pages written in the background leave room for allocations
+static int check_trace_reclaim()
+{
+    size_t nsyncout = swap_stat.nsyncout;
+    
+    assert(nfpage() == 0 && swap_cacheNParked() == 0);
+    
+    // two written and parked, one of them freed
+    assert(swap_reclaim(1, 2) == 2);
+    assert(nfpage() == 1 && swap_cacheNParked() == 1);
+    
+    // a new page, nothing is evicted for it
+    check_touch(CHECK_VALID_VIR_PAGE_NUM);
+    assert(swap_stat.nsyncout == nsyncout);
+    
+    return 0;
+}
+
+// pages that compress well are kept in the pool, and the oldest pool page
+// is written back to disk when the pool is full
+static int check_trace_zpool()
+{
+    extern vma_set_t *c0re_check_vma_set;
+    vma_set_t *set = c0re_check_vma_set;
+    
+    swap_zpool_stat_t old, stat;
+    page_t *pages[CHECK_VALID_PHY_PAGE_NUM];
+    size_t nread = swap_stat.nread, i;
+    unsigned char *pattern = (unsigned char *)(4 * PAGE_SIZE);
+    
+    swap_zpoolGetStat(&old);
+    assert(old.npage == 0 && nfpage() == 0);
+    
+    // the zero page gives its frame to the pool, the two filled ones share
+    // a pool page, and the pattern needs a bigger size class
+    memset((void *)PAGE_SIZE, 0, PAGE_SIZE);
+    memset((void *)(2 * PAGE_SIZE), 0x0b, PAGE_SIZE);
+    memset((void *)(3 * PAGE_SIZE), 0x0c, PAGE_SIZE);
+    
+    for (i = 0; i < PAGE_SIZE; i++) {
+        pattern[i] = i;
+    }
+    
+    for (i = 0; i < CHECK_VALID_PHY_PAGE_NUM; i++) {
+        pages[i] = get_page(set->pgdir, (i + 1) * PAGE_SIZE, NULL);
+    }
+    
+    assert(swap_outPages(set, pages, CHECK_VALID_PHY_PAGE_NUM) == CHECK_VALID_PHY_PAGE_NUM);
+    
+    // the filled pages went to disk to make room for the pattern
+    swap_zpoolGetStat(&stat);
+    assert(stat.npage == 1 && stat.nobj == 1 && stat.nwriteback == old.nwriteback + 2);
+    assert(swap_zpoolHas(swap_getOffset(*get_pte(set->pgdir, 4 * PAGE_SIZE, 0))));
+    
+    // nothing is parked, so the contents come back from the pool and the disk
+    swap_cacheShrink(swap_cacheNParked());
+    
+    for (i = 0; i < PAGE_SIZE; i++) {
+        assert(pattern[i] == (unsigned char)i);
+    }
+    
+    swap_zpoolGetStat(&stat);
+    assert(stat.nload == old.nload + 1 && swap_stat.nread == nread);
+    
+    assert(*(unsigned char *)(2 * PAGE_SIZE) == 0x0b);
+    assert(*(unsigned char *)(3 * PAGE_SIZE - 1) == 0x0b);
+    assert(*(unsigned char *)(3 * PAGE_SIZE) == 0x0c);
+    assert(*(unsigned char *)(4 * PAGE_SIZE - 1) == 0x0c);
+    assert(swap_stat.nread > nread);
+    
+    // a dirty page gives up its copy in the pool, and with the pool
+    // stopped it goes to disk, leaving the frames to the check
+    swap_zpoolSetLimit(0);
+    pattern[0] = 0;
+    
+    pages[0] = get_page(set->pgdir, 4 * PAGE_SIZE, NULL);
+    assert(swap_outPages(set, pages, 1) == 1);
+    
+    swap_zpoolGetStat(&stat);
+    assert(stat.npage == 0 && nfpage() == 1);
+    
+    return 0;
+}
+
 static page_t *check_rp[CHECK_VALID_PHY_PAGE_NUM];
 static pte_t *check_ptep[CHECK_VALID_PHY_PAGE_NUM];
 // static unsigned int check_swap_addr[CHECK_VALID_VIR_PAGE_NUM];
 
-extern free_area_t free_area;
+// a run of two frames is freed on purpose for a two-page allocation
+static int check_trace_range()
+{
+    size_t nrange = swap_stat.nrange, i;
+    page_t *page;
+    
+    assert(nfpage() == 0);
+    
+    // the frames are contiguous, and all of them are mapped
+    assert(palloc_reclaim(2, check_rp[0], CHECK_VALID_PHY_PAGE_NUM));
+    assert(swap_stat.nrange == nrange + 2);
+    
+    assert((page = palloc(2)) == check_rp[0]);
+    pfree(page);
+    
+    for (i = 1; i < CHECK_VALID_PHY_PAGE_NUM + 1; i++) {
+        assert(*(unsigned char *)(i * PAGE_SIZE) == 0x0a + i - 1);
+    }
+    
+    return 0;
+}
+
+extern free_area_t free_area, high_area;
 
 #define _FREED (free_area.freed)
 #define _NFREE (free_area.nfree)
 
-static void check_swap()
+// run check with swap_man, CHECK_VALID_PHY_PAGE_NUM frames and
+// CHECK_VALID_VIR_PAGE_NUM pages, the first frames are filled by check_content_set
+// return value: what check returns
+static int check_swap_run(int (*check)())
 {
     //backup mem env
     int ret, count = 0, total = 0, i;
@@ -217,9 +1265,11 @@ static void check_swap()
         total += cur->nfree;
     }
     
-    assert(total == nfpage());
+    assert(total + high_area.nfree == nfpage());
+    
+    size_t nfree_all = nfpage(), nslot = swap_slotNFree();
     
-    trace("check begin: swap, count %d, total %d", count, total);
+    trace("check begin: swap(%s), count %d, total %d", swap_man->name, count, total);
 
     // now we set the phy pages env
     extern vma_set_t *c0re_check_vma_set;
@@ -235,7 +1285,7 @@ static void check_swap()
     vma_t*vma = vma_new(BEING_CHECK_VALID_VADDR, CHECK_VALID_VADDR, VMA_FLAG_WRITE | VMA_FLAG_READ);
     assert(vma);
 
-    vma_set_insert(set, vma);
+    vma = vma_set_insert(set, vma);
 
     //setup the temp Page Table vaddr 0~4MB
     kprintf("setting up page table for vaddr 0X1000 ... ");
@@ -246,9 +1296,13 @@ static void check_swap()
     
     trace("finished");
 
+    // one block split into single pages, see check_trace_range
+    page_t *block = palloc(CHECK_VALID_PHY_PAGE_NUM);
+    assert(block);
+    
     for (i = 0; i < CHECK_VALID_PHY_PAGE_NUM; i++) {
-        check_rp[i] = palloc(1);
-        assert(check_rp[i]);
+        check_rp[i] = block + i;
+        check_rp[i]->nfree = 1;
         assert(!page_isFree(check_rp[i]));
     }
     
@@ -258,6 +1312,12 @@ static void check_swap()
     _FREED = NULL;
     _NFREE = 0;
     
+    // no highmem either
+    free_area_t high = high_area;
+    
+    high_area.freed = NULL;
+    high_area.nfree = 0;
+    
     for (i = 0; i < CHECK_VALID_PHY_PAGE_NUM; i++) {
         pfree(check_rp[i]);
     }
@@ -288,23 +1348,150 @@ static void check_swap()
     trace("finished");
     
     // now access the virt pages to test  page relpacement algorithm 
-    ret = check_content_access();
-    assert(ret == 0);
+    ret = check();
 
     //restore kernel mem env
+    // the frames are all in use(mapped or parked in the swap cache),
+    // but may have moved to other pages
+    uintptr_t addr;
+    pte_t *ptep;
+    page_t *page;
+    
+    for (i = 0, addr = BEING_CHECK_VALID_VADDR; addr < CHECK_VALID_VADDR; addr += PAGE_SIZE) {
+        ptep = get_pte(pgdir, addr, 0);
+        
+        if (*ptep & PTE_FLAG_P) {
+            assert(i < CHECK_VALID_PHY_PAGE_NUM);
+            check_rp[i++] = pte2page(*ptep);
+            set->nresident--;
+        } else if (*ptep && (page = swap_cacheTake(*ptep))) {
+            assert(i < CHECK_VALID_PHY_PAGE_NUM);
+            check_rp[i++] = page;
+            set->nswapped--;
+        } else if (*ptep) {
+            swap_free(*ptep);
+            set->nswapped--;
+        }
+        
+        *ptep = 0;
+        tlb_invalidate(pgdir, addr);
+    }
+    
+    // zero pages give their frames back when they are swapped out
+    while (_NFREE && i < CHECK_VALID_PHY_PAGE_NUM) {
+        check_rp[i++] = palloc(1);
+    }
+    
+    assert(i == CHECK_VALID_PHY_PAGE_NUM);
+    
+    _NFREE = nfree;
+    _FREED = freed;
+    
+    high_area = high;
+    
     for (i = 0; i < CHECK_VALID_PHY_PAGE_NUM; i++) {
         pfree(check_rp[i]);
-    } 
+    }
+    
+    pfree(pde2page(pgdir[0]));
+    pgdir[0] = 0;
 
     vma_set_free(set);
-     
-    _NFREE = nfree;
-    _FREED = freed;
-
+    c0re_check_vma_set = NULL;
+    
     for (cur = _FREED; cur; cur = cur->next) {
         count--;
         total -= cur->nfree;
     }
+    
+    assert(nfpage() == nfree_all);
+    assert(swap_cacheNParked() == 0);
+    assert(swap_slotNFree() == nslot);
+
+    trace("check success: swap(%s), count %d, total %d", swap_man->name, count, total);
+    
+    return ret;
+}
 
-    trace("check success: swap, count %d, total %d", count, total);
+// run the checks and traces with man
+// the fault counts of the policy traces are only printed, the policies
+// are compared by the swapsim benchmark
+static void check_swap_manager(swap_manager_t *man)
+{
+    int loop, skewed, scan;
+    
+    swap_man = man;
+    assert(swap_man->init() == 0);
+    
+    assert(check_swap_run(check_content_access) == 0);
+    
+    loop = check_swap_run(check_trace_loop);
+    skewed = check_swap_run(check_trace_skewed);
+    scan = check_swap_run(check_trace_scan);
+    
+    trace("swap: %s faults %d on a loop, %d on a skewed trace, %d on a scan",
+          man->name, loop, skewed, scan);
+    
+    // every page is written at most once
+    assert(check_swap_run(check_trace_readLoop) <= CHECK_VALID_VIR_PAGE_NUM);
+    assert(check_swap_run(check_trace_minor) == 0);
+    assert(check_swap_run(check_trace_readahead) == 0);
+    assert(check_swap_run(check_trace_zero) == 0);
+    assert(check_swap_run(check_trace_range) == 0);
+    assert(check_swap_run(check_trace_reclaim) == 0);
+    
+    // with a pool of one page, see check_swap
+    swap_zpoolSetLimit(1);
+    
+    if (swap_zpoolIsOn()) {
+        assert(check_swap_run(check_trace_zpool) == 0);
+    }
+    
+    swap_zpoolSetLimit(0);
+}
+
+// sets over their limit go first, then big idle ones before small busy ones
+static void check_pickSet()
+{
+    vma_set_t *busy = vma_set_new(), *idle = vma_set_new();
+    
+    assert(busy && idle);
+    
+    busy->pgdir = idle->pgdir = c0re_pgdir;
+    
+    busy->nresident = 2000;
+    busy->nactive = 1000;
+    
+    idle->nresident = 1000;
+    idle->nactive = 0;
+    
+    assert(swap_pickSet() == idle);
+    
+    busy->rss_limit = 1000;
+    assert(swap_pickSet() == busy);
+    
+    busy->nresident = idle->nresident = 0;
+    
+    vma_set_free(busy);
+    vma_set_free(idle);
+}
+
+static void check_swap()
+{
+    swap_manager_t *man = swap_man;
+    
+    // the traces count on evicted pages going to disk
+    size_t zpool_limit = swap_zpoolSetLimit(0);
+    
+    check_swap_manager(&swap_manager_fifo);
+    check_swap_manager(&swap_manager_clock);
+    check_swap_manager(&swap_manager_arc);
+    check_swap_manager(&swap_manager_mglru);
+    
+    swap_man = man;
+    assert(swap_man->init() == 0);
+    
+    check_pickSet();
+    
+    swap_zpoolSetLimit(zpool_limit);
 }
@@ -8,24 +8,100 @@
 
 #define SWAP_MAX_RETRY_TIME 16
 
+// background reclaim, see swap_reclaimd
+#define SWAP_RECLAIM_INTERVAL   10  // ticks between two runs
+#define SWAP_RECLAIM_BATCH      32  // max pages written in one run
+
+// recent faults it takes to halve the claim of a set to be reclaimed from
+#define SWAP_ACTIVE_WEIGHT      16
+
 typedef pte_t swap_entry_t;
 
+// accessed bits cleared in one sweep are flushed one by one up to this,
+// the whole tlb is flushed beyond
+#define SWAP_FLUSH_BATCH 16
+
+// pages whose accessed bits are cleared by a swap manager,
+// the tlb entries are dropped at once by swap_flush
+typedef struct {
+    uintptr_t addr[SWAP_FLUSH_BATCH];
+    size_t n;
+} swap_flush_t;
+
+// swap and reclaim counters since boot
+typedef struct {
+    size_t nin;         // pages swapped in from a slot or the pool
+    size_t nminor;      // pages taken back from the swap cache
+    size_t nread;       // pages read from swap slots, readahead included
+    size_t nra;         // pages read ahead
+    size_t nrahit;      // pages read ahead and faulted on later
+    
+    size_t nwrite;      // pages written to swap slots
+    size_t ncluster;    // write commands issued for the pages written
+    size_t nclean;      // clean pages evicted without writing
+    size_t nzero;       // pages of zeros evicted without a slot
+    size_t nzeroin;     // zero pages faulted on, no i/o either
+    size_t nsyncout;    // pages evicted while allocating
+    size_t nbgout;      // pages evicted by background reclaim
+    
+    size_t nscan;       // victims asked of the swap manager
+    size_t ndirect;     // reclaim runs while allocating
+    size_t nbg;         // background reclaim runs
+    size_t nrange;      // pages evicted to free a range, see palloc_reclaim
+    size_t nfail;       // swap outs and ins that failed
+} swap_stat_t;
+
 typedef struct {
     const char *name;
     
     int (*init)();
-    int (*initVMASet)(vma_set_t *set);
+    int (*initVMASet)(vma_set_t *set); // allocate the state of set in swap_data
+    int (*exitVMASet)(vma_set_t *set); // free it
     
-    int (*tick)(vma_set_t *set);
+    int (*tick)(vma_set_t *set); // age pages, called for background reclaim
+    void (*dumpStat)(vma_set_t *set); // print the state of set, may be NULL
     int (*mapSwappable)(vma_set_t *set, uintptr_t addr, page_t *page, int swap_in);
     int (*setUnswappable)(vma_set_t *set, uintptr_t addr);
     
+    // in_tick: the victim is written ahead of time, nobody is waiting for memory
     int (*swapOut)(vma_set_t *set, page_t **result, int in_tick);
     
     int (*check)();
 } swap_manager_t;
 
-#define SWAP_MAX_OFFSET_LIMIT (1 << 24)
+/**
+ * a swap entry is a non-present pte carrying the swap offset above bit 8,
+ * the entry is 64 bits wide with PAE, so the offset can use the whole size_t
+ **/
+#define SWAP_ENTRY_SHIFT 8
+
+#ifdef C0RE_PAE
+    #define SWAP_OFFSET_BITS 32
+#else
+    #define SWAP_OFFSET_BITS (32 - SWAP_ENTRY_SHIFT)
+#endif
+
+#define SWAP_MAX_OFFSET_LIMIT ((uint64_t)1 << SWAP_OFFSET_BITS)
+
+#define SWAP_ENTRY(offset) ((swap_entry_t)(offset) << SWAP_ENTRY_SHIFT)
+#define SWAP_OFFSET(entry) ((size_t)((entry) >> SWAP_ENTRY_SHIFT))
+
+/**
+ * the offset names a swap area(type) in its top bits and a slot of that
+ * area in the others. a run of slots never crosses areas, so offset + i
+ * is the i-th slot after offset as long as it stays in the run.
+ **/
+#define SWAP_TYPE_BITS      2
+#define SWAP_MAX_TYPE       (1 << SWAP_TYPE_BITS)
+#define SWAP_SLOT_BITS      (SWAP_OFFSET_BITS - SWAP_TYPE_BITS)
+#define SWAP_MAX_SLOT_LIMIT ((uint64_t)1 << SWAP_SLOT_BITS)
+
+#define SWAP_MKOFFSET(type, slot) ((size_t)(type) << SWAP_SLOT_BITS | (size_t)(slot))
+#define SWAP_TYPE(offset)   ((size_t)(offset) >> SWAP_SLOT_BITS)
+#define SWAP_SLOT(offset)   ((size_t)(offset) & (((size_t)1 << SWAP_SLOT_BITS) - 1))
+
+// a page of zeros has no slot, slot 0 of the last area is never allocated
+#define SWAP_ZERO_ENTRY     SWAP_ENTRY(SWAP_MKOFFSET(SWAP_MAX_TYPE - 1, 0))
 
 size_t swap_getOffset(swap_entry_t entry);
 
@@ -54,12 +130,30 @@ void swap_enable()
 
 int swap_init();
 int swap_initVMASet(vma_set_t *set);
+int swap_exitVMASet(vma_set_t *set);
 
 int swap_tick(vma_set_t *set);
 int swap_mapSwappable(vma_set_t *set, uintptr_t addr, page_t *page, int swap_in);
 int swap_setUnswappable(vma_set_t *set, uintptr_t addr);
 
+vma_set_t *swap_pickSet();
 int swap_out(vma_set_t *set, int n, int in_tick);
+int swap_outPages(vma_set_t *set, page_t **pages, int n);
+vma_set_t *swap_pageOwner(page_t *page);
 int swap_in(vma_set_t *set, uintptr_t addr, page_t **result);
+void swap_free(swap_entry_t entry);
+
+bool swap_clearRef(vma_set_t *set, page_t *page, swap_flush_t *flush);
+bool swap_clearPteRef(pte_t *ptep, uintptr_t addr, swap_flush_t *flush);
+void swap_flush(vma_set_t *set, swap_flush_t *flush);
+
+void swap_timer();
+size_t swap_reclaimd();
+
+void swap_resetStat();
+void swap_dumpStat();
+
+void swap_setSampleInterval(size_t ticks);
+void swap_sample();
 
 #endif
@@ -0,0 +1,168 @@
+#include "pub/com.h"
+#include "pub/dllist.h"
+
+#include "lib/debug.h"
+
+#include "mem/pmm.h"
+#include "mem/swapcache.h"
+#include "mem/swapslot.h"
+#include "mem/swapzpool.h"
+
+/**
+ * a page is added to the swap cache when its swap slot holds the same
+ * contents, i.e. right after it's read from or written to the slot. the
+ * slot stays valid as long as the page is in the cache, so a page that is
+ * still clean(no PTE_FLAG_D) doesn't need to be written again when evicted.
+ *
+ * an evicted page is parked in the cache instead of being freed at once, a
+ * fault on it takes it back without any i/o. parked pages are kept in lru
+ * order through pra_link and freed by swap_cacheShrink when memory runs out.
+ *
+ * the slot of a cached page belongs to the cache while the page is mapped,
+ * and to the swap entry in the pte while it's parked.
+ **/
+
+static page_t *cache_hash[SWAP_CACHE_NBUCKET];
+
+// parked pages, the oldest at the tail
+static dllist_t parked_head = { &parked_head, &parked_head };
+static size_t nparked = 0;
+
+C0RE_INLINE
+page_t **swap_cacheBucket(swap_entry_t entry)
+{
+    return &cache_hash[SWAP_OFFSET(entry) & (SWAP_CACHE_NBUCKET - 1)];
+}
+
+// swap_cacheAdd - add a page whose contents are in the slot entry
+void swap_cacheAdd(page_t *page, swap_entry_t entry)
+{
+    page_t **bucket = swap_cacheBucket(entry);
+    
+    assert(!page_isCached(page) && !swap_cacheLookup(entry));
+    
+    page->swap_entry = entry;
+    page->swap_next = *bucket;
+    *bucket = page;
+    
+    page_setCached(page);
+}
+
+// remove page from the cache(parked or not)
+static void swap_cacheDel(page_t *page)
+{
+    page_t **pp = swap_cacheBucket(page->swap_entry);
+    
+    assert(page_isCached(page));
+    
+    for (; *pp != page; pp = &(*pp)->swap_next) {
+        assert(*pp);
+    }
+    
+    *pp = page->swap_next;
+    
+    if (page_isParked(page)) {
+        dllist_del(&(page->pra_link));
+        page_resetParked(page);
+        nparked--;
+    }
+    
+    page->swap_entry = 0;
+    page->swap_next = NULL;
+    
+    page_resetCached(page);
+}
+
+// swap_cacheDrop - remove page from the cache when its slot can't be trusted
+//                - the slot is freed unless a pte still refers to it
+void swap_cacheDrop(page_t *page)
+{
+    swap_entry_t entry = page->swap_entry;
+    bool parked = page_isParked(page);
+    
+    swap_cacheDel(page);
+    
+    if (!parked) {
+        swap_zpoolFree(SWAP_OFFSET(entry));
+        swap_slotFree(SWAP_OFFSET(entry));
+    }
+}
+
+// swap_cacheLookup - find the page in the cache for entry
+// return value: the page, or NULL if not found
+page_t *swap_cacheLookup(swap_entry_t entry)
+{
+    page_t *page;
+    
+    for (page = *swap_cacheBucket(entry); page; page = page->swap_next) {
+        if (page->swap_entry == entry) {
+            return page;
+        }
+    }
+    
+    return NULL;
+}
+
+// swap_cachePark - keep an unmapped cached page for later faults
+void swap_cachePark(page_t *page)
+{
+    assert(page_isCached(page) && !page_isParked(page));
+    
+    page_clearRef(page);
+    page_setParked(page);
+    
+    dllist_add(&parked_head, &(page->pra_link));
+    nparked++;
+}
+
+// swap_cacheTake - take a parked page back for mapping
+// return value: the page(still in the cache), or NULL if entry is not parked
+page_t *swap_cacheTake(swap_entry_t entry)
+{
+    page_t *page = swap_cacheLookup(entry);
+    
+    if (!page || !page_isParked(page)) {
+        return NULL;
+    }
+    
+    dllist_del(&(page->pra_link));
+    page_resetParked(page);
+    nparked--;
+    
+    return page;
+}
+
+// swap_cacheShrink - free at most n parked pages, the oldest first
+// return value: # of pages freed
+size_t swap_cacheShrink(size_t n)
+{
+    size_t i;
+    
+    for (i = 0; i < n && nparked; i++) {
+        page_t *page = dll2page(parked_head.prev, pra_link);
+        
+        swap_cacheDel(page);
+        pfree(page);
+    }
+    
+    return i;
+}
+
+// swap_cacheRelease - free page if it's parked, whatever its age
+// return value: whether it was freed
+bool swap_cacheRelease(page_t *page)
+{
+    if (!page_isParked(page)) {
+        return 0;
+    }
+    
+    swap_cacheDel(page);
+    pfree(page);
+    
+    return 1;
+}
+
+size_t swap_cacheNParked()
+{
+    return nparked;
+}
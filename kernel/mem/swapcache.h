@@ -0,0 +1,24 @@
+#ifndef _KERNEL_MEM_SWAPCACHE_H_
+#define _KERNEL_MEM_SWAPCACHE_H_
+
+/* swap cache: pages whose contents are also in a swap slot */
+
+#include "pub/com.h"
+
+#include "mem/mmu.h"
+#include "mem/swap.h"
+
+#define SWAP_CACHE_NBUCKET 256 // must be a power of 2
+
+void swap_cacheAdd(page_t *page, swap_entry_t entry);
+void swap_cacheDrop(page_t *page);
+page_t *swap_cacheLookup(swap_entry_t entry);
+
+void swap_cachePark(page_t *page);
+page_t *swap_cacheTake(swap_entry_t entry);
+size_t swap_cacheShrink(size_t n);
+bool swap_cacheRelease(page_t *page);
+
+size_t swap_cacheNParked();
+
+#endif
@@ -0,0 +1,311 @@
+#include "pub/com.h"
+#include "pub/error.h"
+#include "pub/string.h"
+#include "pub/atomic.h"
+
+#include "lib/debug.h"
+
+#include "mem/pmm.h"
+#include "mem/swap.h"
+#include "mem/swapslot.h"
+
+/**
+ * each swap area has its own bitmap. slots are allocated next-fit in an
+ * area: the search starts where the last run ended, so victims swapped
+ * out one after another land sequentially on disk even if they are freed
+ * in a different order. full words of the bitmap are skipped at once.
+ *
+ * runs come from the areas of the highest priority that have free slots.
+ * among those, an area keeps giving runs until it gave SWAP_SLOT_STRIPE
+ * slots, then the next one takes over. a run is never cut, so writeback
+ * and readahead keep whole clusters on a device while the clusters
+ * themselves are spread over all of them.
+ *
+ * slot 0 of each area is never allocated, since a zero pte is not a swap
+ * entry.
+ **/
+
+typedef struct {
+    uint32_t *map;          // bit set if the slot is in use
+    size_t total;           // slot 0 included
+    size_t nfree;
+    size_t cursor;          // where the next search starts
+    size_t base;            // index of slot 0, see swap_slotIndex
+    int prio;
+} slot_area_t;
+
+static slot_area_t slot_areas[SWAP_MAX_TYPE];
+static size_t slot_narea = 0;
+static size_t slot_total = 0;       // of all areas, slot 0 included
+static size_t slot_nfree = 0;
+static size_t slot_last = 0;        // area the last run came from
+static size_t slot_nstripe = 0;     // slots it gave since it took over
+
+static void check_slot();
+
+static int swap_slotSetup(const size_t *nslot, const int *prio, size_t narea)
+{
+    size_t type, size;
+    
+    assert(narea && narea <= SWAP_MAX_TYPE);
+    
+    memset(slot_areas, 0, sizeof(slot_areas));
+    slot_total = slot_nfree = 0;
+    
+    for (type = 0; type < narea; type++) {
+        slot_area_t *area = &slot_areas[type];
+    
+        assert(nslot[type] > 1 && nslot[type] <= SWAP_MAX_SLOT_LIMIT);
+        size = ROUNDUP(nslot[type], 32) / 8;
+    
+        if (!(area->map = kmalloc(size))) {
+            while (type--) {
+                kfree(slot_areas[type].map, ROUNDUP(slot_areas[type].total, 32) / 8);
+            }
+    
+            return -E_NO_MEM;
+        }
+    
+        memset(area->map, 0, size);
+        btsl(0, area->map);
+    
+        area->total = nslot[type];
+        area->nfree = nslot[type] - 1;
+        area->cursor = 1;
+        area->base = slot_total;
+        area->prio = prio[type];
+    
+        slot_total += area->total;
+        slot_nfree += area->nfree;
+    }
+    
+    slot_narea = narea;
+    slot_last = 0;
+    slot_nstripe = 0;
+    
+    return 0;
+}
+
+// swap_slotInit - set up the allocator for narea areas of nslot[i] slots
+// and priority prio[i]
+// return value: 0 on success, -E_NO_MEM if a bitmap can't be allocated
+int swap_slotInit(const size_t *nslot, const int *prio, size_t narea)
+{
+    int r;
+    
+    if ((r = swap_slotSetup(nslot, prio, narea))) {
+        return r;
+    }
+    
+    check_slot();
+    
+    return 0;
+}
+
+C0RE_INLINE
+bool swap_slotIsFree(slot_area_t *area, size_t slot)
+{
+    return !btl(slot, area->map);
+}
+
+// first free slot of area in [from, total), or total if there is none
+static size_t swap_slotFind(slot_area_t *area, size_t from)
+{
+    while (from < area->total) {
+        if (from % 32 == 0 && area->map[from / 32] == 0xffffffff) {
+            from += 32;
+        } else if (swap_slotIsFree(area, from)) {
+            return from;
+        } else {
+            from++;
+        }
+    }
+    
+    return area->total;
+}
+
+// the area the next run comes from, there must be a free slot somewhere
+static slot_area_t *swap_slotPick()
+{
+    slot_area_t *last = &slot_areas[slot_last];
+    size_t type, i;
+    int prio = 0;
+    bool found = 0;
+    
+    for (type = 0; type < slot_narea; type++) {
+        if (slot_areas[type].nfree && (!found || slot_areas[type].prio > prio)) {
+            prio = slot_areas[type].prio;
+            found = 1;
+        }
+    }
+    
+    assert(found);
+    
+    if (last->nfree && last->prio == prio && slot_nstripe < SWAP_SLOT_STRIPE) {
+        return last;
+    }
+    
+    // round robin, starting after the last one
+    for (i = 1; i <= slot_narea; i++) {
+        type = (slot_last + i) % slot_narea;
+    
+        if (slot_areas[type].nfree && slot_areas[type].prio == prio) {
+            slot_last = type;
+            slot_nstripe = 0;
+            break;
+        }
+    }
+    
+    return &slot_areas[slot_last];
+}
+
+// swap_slotAlloc - allocate a run of at most n contiguous slots
+// parameters:
+//  offset: the first slot of the run is stored here
+// return value: length of the run, 0 if all slots are in use
+size_t swap_slotAlloc(size_t n, size_t *offset)
+{
+    slot_area_t *area;
+    size_t start, len;
+    
+    if (!slot_nfree || !n) {
+        return 0;
+    }
+    
+    area = swap_slotPick();
+    
+    start = swap_slotFind(area, area->cursor);
+    
+    if (start == area->total) {
+        start = swap_slotFind(area, 1);
+        assert(start < area->total);
+    }
+    
+    for (len = 0; len < n && start + len < area->total &&
+                  swap_slotIsFree(area, start + len); len++) {
+        btsl(start + len, area->map);
+    }
+    
+    area->nfree -= len;
+    area->cursor = start + len;
+    slot_nfree -= len;
+    slot_nstripe += len;
+    
+    *offset = SWAP_MKOFFSET(area - slot_areas, start);
+    
+    return len;
+}
+
+// swap_slotFree - give back a slot
+void swap_slotFree(size_t offset)
+{
+    slot_area_t *area = &slot_areas[SWAP_TYPE(offset)];
+    size_t slot = SWAP_SLOT(offset);
+    
+    assert(swap_slotIsValid(offset) && !swap_slotIsFree(area, slot));
+    
+    btrl(slot, area->map);
+    area->nfree++;
+    slot_nfree++;
+}
+
+// swap_slotIsValid - whether offset names a slot that can be allocated
+bool swap_slotIsValid(size_t offset)
+{
+    size_t type = SWAP_TYPE(offset), slot = SWAP_SLOT(offset);
+    
+    return type < slot_narea && slot && slot < slot_areas[type].total;
+}
+
+// swap_slotIndex - number the slots of all areas one after another, for
+// tables kept over every slot
+// return value: the index of offset, swap_slotNIndex() if it's not valid
+size_t swap_slotIndex(size_t offset)
+{
+    if (!swap_slotIsValid(offset)) {
+        return slot_total;
+    }
+    
+    return slot_areas[SWAP_TYPE(offset)].base + SWAP_SLOT(offset);
+}
+
+size_t swap_slotNIndex()
+{
+    return slot_total;
+}
+
+size_t swap_slotNFree()
+{
+    return slot_nfree;
+}
+
+// # of slots that can be allocated, slot 0 of each area aside
+size_t swap_slotNSlot()
+{
+    return slot_total - slot_narea;
+}
+
+bool swap_slotIsScarce()
+{
+    return SWAP_SLOT_SCARCE(slot_nfree, swap_slotNSlot());
+}
+
+// on areas of its own: two striped ones of priority 1, and one of 0
+static void check_slot()
+{
+    static const size_t nslot[] = { 65, 65, 65 };
+    static const int prio[] = { 1, 1, 0 };
+    slot_area_t areas[SWAP_MAX_TYPE];
+    size_t narea = slot_narea, total = slot_total, nfree = slot_nfree;
+    size_t last = slot_last, nstripe = slot_nstripe;
+    size_t a, b, c, n, len, i;
+    
+    memcpy(areas, slot_areas, sizeof(areas));
+    assert(swap_slotSetup(nslot, prio, 3) == 0);
+    
+    assert(swap_slotNSlot() == 192 && swap_slotNIndex() == 195);
+    assert(swap_slotIsValid(SWAP_MKOFFSET(2, 64)));
+    assert(!swap_slotIsValid(SWAP_MKOFFSET(0, 0)));
+    assert(!swap_slotIsValid(SWAP_MKOFFSET(2, 65)));
+    assert(!swap_slotIsValid(SWAP_MKOFFSET(3, 1)));
+    assert(swap_slotIndex(SWAP_MKOFFSET(1, 5)) == 70);
+    
+    // runs follow each other until the stripe is used up
+    assert(swap_slotAlloc(8, &a) == 8 && a == SWAP_MKOFFSET(0, 1));
+    assert(swap_slotAlloc(8, &b) == 8 && b == a + 8);
+    
+    // then the next area of the same priority takes over, the last run of
+    // a stripe may go past its end
+    assert(swap_slotAlloc(8, &c) == 8 && c == SWAP_MKOFFSET(1, 1));
+    assert(swap_slotAlloc(16, &c) == 16 && c == SWAP_MKOFFSET(1, 9));
+    assert(swap_slotAlloc(1, &c) == 1 && c == a + 16);
+    
+    // the lower priority is used only when the higher is full
+    for (n = 41; (len = swap_slotAlloc(SWAP_SLOT_STRIPE, &c)); n += len) {
+        if (SWAP_TYPE(c) == 2) {
+            break;
+        }
+    }
+    
+    assert(n == 128 && c == SWAP_MKOFFSET(2, 1) && len == SWAP_SLOT_STRIPE);
+    
+    // and the higher priority is back as soon as it has room, the cursor
+    // wraps and the run stops at a used slot
+    swap_slotFree(a);
+    assert(swap_slotAlloc(4, &c) == 1 && c == a);
+    
+    assert(slot_nfree == 192 - 128 - SWAP_SLOT_STRIPE);
+    
+    for (i = 0; i < 3; i++) {
+        kfree(slot_areas[i].map, ROUNDUP(nslot[i], 32) / 8);
+    }
+    
+    memcpy(slot_areas, areas, sizeof(areas));
+    slot_narea = narea;
+    slot_total = total;
+    slot_nfree = nfree;
+    slot_last = last;
+    slot_nstripe = nstripe;
+    
+    trace("check success: swap slot");
+}
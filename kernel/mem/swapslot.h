@@ -0,0 +1,28 @@
+#ifndef _KERNEL_MEM_SWAPSLOT_H_
+#define _KERNEL_MEM_SWAPSLOT_H_
+
+/* swap slot allocator: a bitmap over each swap area, one bit per page */
+
+#include "pub/com.h"
+
+// slots more than half used, pages swapped in don't keep theirs
+#define SWAP_SLOT_SCARCE(nfree, total) ((nfree) < (total) / 2)
+
+// slots taken from an area before moving to the next one of the same
+// priority, about one write cluster
+#define SWAP_SLOT_STRIPE 16
+
+int swap_slotInit(const size_t *nslot, const int *prio, size_t narea);
+
+size_t swap_slotAlloc(size_t n, size_t *offset);
+void swap_slotFree(size_t offset);
+
+bool swap_slotIsValid(size_t offset);
+size_t swap_slotIndex(size_t offset);
+size_t swap_slotNIndex();
+
+size_t swap_slotNFree();
+size_t swap_slotNSlot();
+bool swap_slotIsScarce();
+
+#endif
@@ -0,0 +1,353 @@
+#include "pub/com.h"
+#include "pub/error.h"
+#include "pub/string.h"
+#include "pub/dllist.h"
+#include "pub/lz.h"
+
+#include "lib/debug.h"
+
+#include "fs/swapfs.h"
+
+#include "mem/pmm.h"
+#include "mem/swap.h"
+#include "mem/swapslot.h"
+#include "mem/swapzpool.h"
+
+/**
+ * a page that compresses to less than half its size is kept in the pool
+ * instead of being written to its slot. the slot is still allocated and
+ * the pte holds its entry as usual, the pool only replaces the disk
+ * behind it, see swap_out and swap_in.
+ *
+ * pool pages are lowmem pages holding objects of one size class, with a
+ * header at the start. classes with room are kept in class lists, and all
+ * pool pages in allocation order. when the pool is at its limit, the
+ * oldest page is emptied by writing its objects to their slots on disk.
+ **/
+
+// header at the start of each pool page
+typedef struct {
+    dllist_t class_link;    // in the list of its class while it has room
+    dllist_t lru_link;      // in the list of all pool pages, the oldest at the tail
+    uint16_t cls;
+    uint16_t nused;
+} zpool_page_t;
+
+// a stored page
+typedef struct {
+    uint32_t offset;        // slot it belongs to, 0 if the object is free
+    uint16_t len;           // compressed size
+    uint16_t reserved;
+    uint8_t data[0];
+} zpool_obj_t;
+
+// the biggest class still fits two objects in a page
+#define ZPOOL_NCLASS        ((PAGE_SIZE - sizeof(zpool_page_t)) / 2 / ZPOOL_CLASS_SIZE)
+#define ZPOOL_MAX_LEN       (ZPOOL_NCLASS * ZPOOL_CLASS_SIZE - sizeof(zpool_obj_t))
+
+#define zpool_objSize(cls)  (((cls) + 1) * ZPOOL_CLASS_SIZE)
+#define zpool_nobjOf(cls)   ((PAGE_SIZE - sizeof(zpool_page_t)) / zpool_objSize(cls))
+
+static zpool_obj_t **zpool_map = NULL;  // object of each slot by swap_slotIndex, NULL if it's on disk
+static size_t zpool_nslot = 0;
+static size_t zpool_maxPage = 0;
+
+static dllist_t class_head[ZPOOL_NCLASS];
+static dllist_t lru_head = { &lru_head, &lru_head };
+
+static swap_zpool_stat_t zpool_stat;
+
+// scratch space, pages are compressed and written back one at a time
+static uint16_t zpool_table[LZ_HASH_SIZE];
+static uint8_t zpool_buf[ZPOOL_MAX_LEN];
+static uint8_t zpool_wbBuf[PAGE_SIZE];
+
+static void check_zpool();
+
+// swap_zpoolInit - set up the pool for nslot slots
+// return value: 0 on success, -E_NO_MEM if the slot map can't be allocated
+int swap_zpoolInit(size_t nslot)
+{
+    size_t size = nslot * sizeof(*zpool_map), i;
+    
+    if (!(zpool_map = kmalloc(size))) {
+        return -E_NO_MEM;
+    }
+    
+    memset(zpool_map, 0, size);
+    
+    for (i = 0; i < ZPOOL_NCLASS; i++) {
+        dllist_init(&class_head[i]);
+    }
+    
+    zpool_nslot = nslot;
+    zpool_maxPage = c0re_npage_low * ZPOOL_MAX_PERCENT / 100;
+    
+    check_zpool();
+    
+    trace("swap: compressed pool of at most %d pages", zpool_maxPage);
+    
+    return 0;
+}
+
+C0RE_INLINE
+zpool_obj_t *zpool_obj(zpool_page_t *zp, size_t i)
+{
+    return (zpool_obj_t *)((uint8_t *)(zp + 1) + i * zpool_objSize(zp->cls));
+}
+
+C0RE_INLINE
+zpool_page_t *zpool_pageOf(zpool_obj_t *obj)
+{
+    return ROUNDDOWN((zpool_page_t *)obj, PAGE_SIZE);
+}
+
+static void zpool_objFree(zpool_obj_t *obj)
+{
+    zpool_page_t *zp = zpool_pageOf(obj);
+    
+    zpool_map[swap_slotIndex(obj->offset)] = NULL;
+    zpool_stat.nobj--;
+    zpool_stat.nbytes -= obj->len;
+    
+    obj->offset = 0;
+    
+    if (zp->nused-- == zpool_nobjOf(zp->cls)) {
+        // has room again
+        dllist_add(&class_head[zp->cls], &(zp->class_link));
+    }
+    
+    if (!zp->nused) {
+        dllist_del(&(zp->class_link));
+        dllist_del(&(zp->lru_link));
+    
+        pfree(kva2page(zp));
+        zpool_stat.npage--;
+    }
+}
+
+// zpool_writeback - empty the oldest pool page by writing its objects to disk
+// return value: 0 if the page is freed
+static int zpool_writeback()
+{
+    zpool_page_t *zp;
+    zpool_obj_t *obj;
+    size_t i;
+    
+    if (dllist_empty(&lru_head)) {
+        return -E_NO_MEM;
+    }
+    
+    zp = to_struct(lru_head.prev, zpool_page_t, lru_link);
+    
+    for (i = 0; i < zpool_nobjOf(zp->cls); i++) {
+        obj = zpool_obj(zp, i);
+    
+        if (!obj->offset) {
+            continue;
+        }
+    
+        size_t n = lz_decompress(obj->data, obj->len, zpool_wbBuf, PAGE_SIZE);
+        assert(n == PAGE_SIZE);
+    
+        if (swapfs_writeBuf(SWAP_ENTRY(obj->offset), zpool_wbBuf)) {
+            trace("swap: failed to write back slot %d", obj->offset);
+            return -E_NO_MEM;
+        }
+    
+        zpool_stat.nwriteback++;
+    
+        // the page goes with the last object
+        bool last = zp->nused == 1;
+        zpool_objFree(obj);
+    
+        if (last) {
+            break;
+        }
+    }
+    
+    return 0;
+}
+
+static zpool_obj_t *zpool_objAlloc(size_t cls)
+{
+    zpool_page_t *zp;
+    zpool_obj_t *obj;
+    size_t i;
+    
+    if (dllist_empty(&class_head[cls])) {
+        page_t *page;
+    
+        // nothing is reclaimed for the pool, it's used while reclaiming
+        if ((zpool_stat.npage >= zpool_maxPage && zpool_writeback()) ||
+            !(page = palloc_low_try())) {
+            return NULL;
+        }
+    
+        zp = page2kva(page);
+        memset(zp, 0, PAGE_SIZE);
+        zp->cls = cls;
+    
+        dllist_add(&class_head[cls], &(zp->class_link));
+        dllist_add(&lru_head, &(zp->lru_link));
+        zpool_stat.npage++;
+    }
+    
+    zp = to_struct(dllist_next(&class_head[cls]), zpool_page_t, class_link);
+    
+    for (i = 0; (obj = zpool_obj(zp, i))->offset; i++) {
+        assert(i < zpool_nobjOf(cls));
+    }
+    
+    if (++zp->nused == zpool_nobjOf(cls)) {
+        dllist_del(&(zp->class_link));
+    }
+    
+    return obj;
+}
+
+// swap_zpoolStore - compress page into the pool for slot offset
+// return value: 0 on success, -E_INVAL if it doesn't compress well,
+//               -E_NO_MEM if there is no room
+int swap_zpoolStore(size_t offset, page_t *page)
+{
+    size_t idx = swap_slotIndex(offset);
+    zpool_obj_t *obj;
+    
+    if (!zpool_map) {
+        return -E_NO_MEM;
+    }
+    
+    assert(idx < zpool_nslot && !zpool_map[idx]);
+    
+    void *kva = kmap(page);
+    size_t len = lz_compress(kva, PAGE_SIZE, zpool_buf, ZPOOL_MAX_LEN, zpool_table);
+    kunmap(kva);
+    
+    if (!len) {
+        zpool_stat.nreject++;
+        return -E_INVAL;
+    }
+    
+    if (!(obj = zpool_objAlloc((sizeof(zpool_obj_t) + len - 1) / ZPOOL_CLASS_SIZE))) {
+        zpool_stat.nfull++;
+        return -E_NO_MEM;
+    }
+    
+    obj->offset = offset;
+    obj->len = len;
+    memcpy(obj->data, zpool_buf, len);
+    
+    zpool_map[idx] = obj;
+    zpool_stat.nobj++;
+    zpool_stat.nbytes += len;
+    zpool_stat.nstore++;
+    
+    return 0;
+}
+
+// swap_zpoolLoad - decompress the contents of slot offset into page
+// return value: 0 on success, -E_INVAL if the slot is not in the pool
+int swap_zpoolLoad(size_t offset, page_t *page)
+{
+    if (!swap_zpoolHas(offset)) {
+        return -E_INVAL;
+    }
+    
+    zpool_obj_t *obj = zpool_map[swap_slotIndex(offset)];
+    
+    void *kva = kmap(page);
+    size_t n = lz_decompress(obj->data, obj->len, kva, PAGE_SIZE);
+    kunmap(kva);
+    
+    assert(n == PAGE_SIZE);
+    zpool_stat.nload++;
+    
+    return 0;
+}
+
+// swap_zpoolSetLimit - let the pool grow to npage pages, 0 stops storing,
+//                    - pages already stored stay until they're loaded or freed
+// return value: the old limit
+size_t swap_zpoolSetLimit(size_t npage)
+{
+    size_t old = zpool_maxPage;
+    zpool_maxPage = npage;
+    
+    return old;
+}
+
+bool swap_zpoolIsOn()
+{
+    return zpool_map != NULL && zpool_maxPage;
+}
+
+bool swap_zpoolHas(size_t offset)
+{
+    return zpool_map && swap_slotIndex(offset) < zpool_nslot &&
+           zpool_map[swap_slotIndex(offset)];
+}
+
+// swap_zpoolFree - the slot offset is freed, so is its copy in the pool
+void swap_zpoolFree(size_t offset)
+{
+    if (swap_zpoolHas(offset)) {
+        zpool_objFree(zpool_map[swap_slotIndex(offset)]);
+    }
+}
+
+void swap_zpoolGetStat(swap_zpool_stat_t *stat)
+{
+    *stat = zpool_stat;
+}
+
+static void check_zpool()
+{
+    swap_zpool_stat_t stat = zpool_stat;
+    page_t *a = palloc_s(1), *b = palloc_s(1);
+    uint8_t *ka, *kb;
+    uint32_t seed = 1;
+    size_t i;
+    
+    // text compresses well
+    ka = kmap(a);
+    
+    for (i = 0; i < PAGE_SIZE; i++) {
+        ka[i] = "c0re swap pool "[i % 15];
+    }
+    
+    kunmap(ka);
+    
+    assert(swap_zpoolStore(1, a) == 0 && swap_zpoolHas(1));
+    assert(zpool_stat.npage == stat.npage + 1);
+    assert(zpool_stat.nbytes - stat.nbytes < PAGE_SIZE / 8);
+    
+    // noise doesn't
+    kb = kmap(b);
+    
+    for (i = 0; i < PAGE_SIZE; i++) {
+        seed = seed * 1103515245 + 12345;
+        kb[i] = seed >> 16;
+    }
+    
+    kunmap(kb);
+    
+    assert(swap_zpoolStore(2, b) == -E_INVAL && !swap_zpoolHas(2));
+    
+    // decompressed into another frame
+    assert(swap_zpoolLoad(1, b) == 0);
+    
+    ka = kmap(a);
+    kb = kmap(b);
+    assert(memcmp(ka, kb, PAGE_SIZE) == 0);
+    kunmap(kb);
+    kunmap(ka);
+    
+    swap_zpoolFree(1);
+    assert(!swap_zpoolHas(1) && zpool_stat.npage == stat.npage);
+    
+    pfree(a);
+    pfree(b);
+    
+    zpool_stat = stat;
+}
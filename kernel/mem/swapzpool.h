@@ -0,0 +1,36 @@
+#ifndef _KERNEL_MEM_SWAPZPOOL_H_
+#define _KERNEL_MEM_SWAPZPOOL_H_
+
+/* compressed swap pool: slot contents kept in memory instead of on disk */
+
+#include "pub/com.h"
+
+#include "mem/mmu.h"
+
+#define ZPOOL_MAX_PERCENT   20 // of lowmem pages, the oldest pool pages are written to disk over it
+#define ZPOOL_CLASS_SIZE    64 // object sizes are multiples of this
+
+typedef struct {
+    size_t npage;       // pages used by the pool
+    size_t nobj;        // pages stored
+    size_t nbytes;      // compressed size of them
+
+    size_t nstore;      // pages compressed into the pool
+    size_t nreject;     // pages that don't compress well
+    size_t nfull;       // pages that found no room in the pool
+    size_t nload;       // pages decompressed from the pool
+    size_t nwriteback;  // pages moved to disk to make room
+} swap_zpool_stat_t;
+
+int swap_zpoolInit(size_t nslot);
+size_t swap_zpoolSetLimit(size_t npage);
+bool swap_zpoolIsOn();
+
+int swap_zpoolStore(size_t offset, page_t *page);
+int swap_zpoolLoad(size_t offset, page_t *page);
+bool swap_zpoolHas(size_t offset);
+void swap_zpoolFree(size_t offset);
+
+void swap_zpoolGetStat(swap_zpool_stat_t *stat);
+
+#endif
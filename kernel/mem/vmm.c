@@ -1,10 +1,17 @@
 #include "pub/com.h"
+#include "pub/x86.h"
 #include "pub/dllist.h"
 #include "pub/error.h"
+#include "pub/string.h"
 
 #include "mem/swap.h"
+#include "mem/swapcache.h"
 #include "mem/vmm.h"
 #include "mem/pmm.h"
+#include "mem/ksm.h"
+
+// all vma sets
+static dllist_t vma_set_list = { &vma_set_list, &vma_set_list };
 
 vma_t *vma_new(uintptr_t start, uintptr_t end, uint32_t flags)
 {
@@ -36,18 +43,43 @@ vma_set_t *vma_set_new()
         set->mcount = 0;
 
         set->pgdir = NULL;
+        
+        memset(set->nfault, 0, sizeof(set->nfault));
+        
+        set->nresident = set->nswapped = 0;
+        set->rss_limit = 0;
+        set->nactive = 0;
 
+        set->swap_data = NULL;
         if (swap_hasInit()) swap_initVMASet(set);
-        else set->swap_data = NULL;
+        
+        dllist_add_before(&vma_set_list, &(set->link));
     }
 
     return set;
 }
 
+// vma_set_next - iterate through all vma sets
+// return value: the set after set(or the first one if set is NULL),
+//               NULL if there is no more
+vma_set_t *vma_set_next(vma_set_t *set)
+{
+    dllist_t *dll = dllist_next(set ? &(set->link) : &vma_set_list);
+    return dll != &vma_set_list ? dll2vmaset(dll, link) : NULL;
+}
+
 void vma_set_free(vma_set_t *set)
 {
     dllist_t *list = &(set->mset), *dll;
     
+    // the owner has unmapped everything
+    assert(set->nresident == 0 && set->nswapped == 0);
+    
+    ksm_forgetSet(set);
+    dllist_del(&(set->link));
+    
+    if (set->swap_data) swap_exitVMASet(set);
+    
     while ((dll = dllist_next(list)) != list) {
         dllist_del(dll);
         kfree(dll2vma(dll, link), sizeof(vma_t));  // kfree vma
@@ -65,7 +97,18 @@ bool is_vma_overlap(vma_t *prev, vma_t *next)
              next->start < next->end);
 }
 
-void vma_set_insert(vma_set_t *set, vma_t *vma)
+// two vma's can be merged if they are adjacent and look the same
+C0RE_INLINE
+bool is_vma_mergeable(vma_t *prev, vma_t *next)
+{
+    return prev->end == next->start && prev->flags == next->flags;
+}
+
+// vma_set_insert - insert a vma into the set, merging it with its neighbours
+//                  if they are adjacent and compatible
+// return value: the vma covering the inserted range, if it's not the
+//               vma passed in, that vma has been freed
+vma_t *vma_set_insert(vma_set_t *set, vma_t *vma)
 {
     assert(vma->start < vma->end);
     
@@ -86,20 +129,54 @@ void vma_set_insert(vma_set_t *set, vma_t *vma)
 
     next = dllist_next(prev);
 
+    vma_t *prevvma = prev != list ? dll2vma(prev, link) : NULL;
+    vma_t *nextvma = next != list ? dll2vma(next, link) : NULL;
+
     /* check overlap(of vma and prev) */
-    if (prev != list) {
-        assert(!is_vma_overlap(dll2vma(prev, link), vma));
+    if (prevvma) {
+        assert(!is_vma_overlap(prevvma, vma));
     }
     
     /* check overlap(of vma and next) */
-    if (next != list) {
-        assert(!is_vma_overlap(vma, dll2vma(next, link)));
+    if (nextvma) {
+        assert(!is_vma_overlap(vma, nextvma));
+    }
+
+    if (prevvma && is_vma_mergeable(prevvma, vma)) {
+        // prev absorbs vma
+        prevvma->end = vma->end;
+        kfree(vma, sizeof(*vma));
+        vma = prevvma;
+        
+        if (nextvma && is_vma_mergeable(vma, nextvma)) {
+            // and next too
+            vma->end = nextvma->end;
+            dllist_del(next);
+            
+            if (set->mcache == nextvma) {
+                set->mcache = vma;
+            }
+            
+            kfree(nextvma, sizeof(*nextvma));
+            set->mcount--;
+        }
+        
+        return vma;
+    }
+    
+    if (nextvma && is_vma_mergeable(vma, nextvma)) {
+        // next absorbs vma
+        nextvma->start = vma->start;
+        kfree(vma, sizeof(*vma));
+        return nextvma;
     }
 
     vma->set = set;
     dllist_add_after(prev, &(vma->link));
 
     set->mcount++;
+    
+    return vma;
 }
 
 // find which vma the addr is at
@@ -132,9 +209,221 @@ vma_t *vma_set_find(vma_set_t *set, uintptr_t addr)
     return vma;
 }
 
+C0RE_INLINE
+uint32_t vma_perm(vma_t *vma)
+{
+    uint32_t perm = PTE_FLAG_U;
+    
+    if (vma->flags & VMA_FLAG_WRITE) {
+        perm |= PTE_FLAG_W;
+    }
+    
+    return perm;
+}
+
+C0RE_INLINE
+void vma_mapSwappable(vma_set_t *set, uintptr_t addr, page_t *page, int swap_in)
+{
+    if (swap_hasInit() && set->swap_data) {
+        swap_mapSwappable(set, addr, page, swap_in);
+        page->pra_vaddr = addr;
+    }
+}
+
+// vma_set_setRSSLimit - limit the number of resident pages of set(0 for no limit)
+//                     - pages over the limit are swapped out when the set grows
+void vma_set_setRSSLimit(vma_set_t *set, size_t npage)
+{
+    set->rss_limit = npage;
+}
+
+// make room for one more resident page in set
+// return value: 0 if there is room, -E_NO_MEM if set is at its limit
+//               and nothing could be swapped out
+static int vma_reserveResident(vma_set_t *set)
+{
+    if (!set->rss_limit || set->nresident < set->rss_limit) {
+        return 0;
+    }
+    
+    if (swap_hasInit() && set->swap_data) {
+        swap_out(set, set->nresident - set->rss_limit + 1, 0);
+    }
+    
+    return set->nresident < set->rss_limit ? 0 : -E_NO_MEM;
+}
+
+// vma_set_unmap - drop the page or swap entry set has at addr, keeping
+//               - the resident and swapped counts exact
+void vma_set_unmap(vma_set_t *set, uintptr_t addr)
+{
+    pte_t *ptep = get_pte(set->pgdir, addr, 0);
+    
+    if (!ptep || !*ptep) {
+        return;
+    }
+    
+    if (*ptep & PTE_FLAG_P) {
+        swap_setUnswappable(set, addr);
+        
+        assert(set->nresident);
+        set->nresident--;
+    } else {
+        assert(set->nswapped);
+        set->nswapped--;
+    }
+    
+    page_remove(set->pgdir, addr);
+}
+
+// max number of pages allocated at once in vma_populate
+#define VMA_POPULATE_BATCH 32
+
+// vma_populate - map every page in [start, end) ahead of time so that
+//                no page fault happens when they are accessed later
+// parameters:
+//  set:   the vma set, every page in the range must be covered by its vma's
+//  write: the range will be written(vma's need to be writable)
+// return value: number of pages resident from start on, which is less
+//               than the number of pages in the range if memory runs out
+//               or the rss limit of set is reached(the pages populated are
+//               never evicted for the ones after them),
+//               or -E_INVAL if the range is not valid
+int vma_populate(vma_set_t *set, uintptr_t start, uintptr_t end, bool write)
+{
+    page_t *batch[VMA_POPULATE_BATCH], *page;
+    size_t nbatch = 0, used = 0;
+    
+    uintptr_t addr;
+    pte_t *ptep;
+    vma_t *vma;
+    
+    int count = 0;
+    
+    start = ROUNDDOWN(start, PAGE_SIZE);
+    end = ROUNDUP(end, PAGE_SIZE);
+    
+    if (!set || start >= end) {
+        return -E_INVAL;
+    }
+    
+    // check the whole range before touching anything
+    for (addr = start; addr < end; addr += PAGE_SIZE) {
+        vma = vma_set_find(set, addr);
+        
+        if (!vma ||
+            (write && !(vma->flags & VMA_FLAG_WRITE)) ||
+            (!write && !(vma->flags & (VMA_FLAG_READ | VMA_FLAG_EXEC)))) {
+            return -E_INVAL;
+        }
+    }
+    
+    for (addr = start; addr < end;) {
+        // only look up the page directory once per page table
+        if ((ptep = get_pte(set->pgdir, addr, true)) == NULL) {
+            trace("vma_populate: cannot alloc page table");
+            goto out;
+        }
+        
+        do {
+            vma = vma_set_find(set, addr);
+            
+            if (*ptep & PTE_FLAG_P) {
+                // already there
+            } else if ((count && set->rss_limit && set->nresident >= set->rss_limit) ||
+                       vma_reserveResident(set)) {
+                // room could only be made by evicting pages of the range
+                trace("vma_populate: rss limit reached at %p", (void *)addr);
+                goto out;
+            } else if (*ptep) {
+                // swap entry
+                if (!swap_hasInit() || swap_in(set, addr, &page)) {
+                    trace("vma_populate: failed to swap in %p", (void *)addr);
+                    goto out;
+                }
+                
+                page_incRef(page);
+                *ptep = page2pa(page) | PTE_FLAG_P | vma_perm(vma);
+                vma_mapSwappable(set, addr, page, 1);
+                
+                set->nresident++;
+            } else {
+                if (used == nbatch) {
+                    nbatch = (end - addr) / PAGE_SIZE;
+                    
+                    if (nbatch > VMA_POPULATE_BATCH) {
+                        nbatch = VMA_POPULATE_BATCH;
+                    }
+                    
+                    nbatch = palloc_batch(batch, nbatch);
+                    used = 0;
+                    
+                    if (!nbatch) {
+                        trace("vma_populate: out of memory at %p", (void *)addr);
+                        goto out;
+                    }
+                }
+                
+                page = batch[used++];
+                
+                // not present before, so no need to invalidate tlb
+                page_incRef(page);
+                *ptep = page2pa(page) | PTE_FLAG_P | vma_perm(vma);
+                vma_mapSwappable(set, addr, page, 0);
+                
+                set->nresident++;
+            }
+            
+            count++;
+            addr += PAGE_SIZE;
+            ptep++;
+        } while (addr < end && PT_INDEX(addr) != 0);
+    }
+    
+out:
+    // give back what's left in the last batch
+    while (used < nbatch) {
+        pfree(batch[used++]);
+    }
+    
+    return count;
+}
+
+// vmm_dumpSetStat - print memory usage of all vma sets
+void vmm_dumpSetStat()
+{
+    vma_set_t *set;
+    
+    for (set = vma_set_next(NULL); set; set = vma_set_next(set)) {
+        kprintf("vma set %p: %u vma, resident %u, swapped %u, limit ",
+                set, set->mcount, set->nresident, set->nswapped);
+        
+        if (set->rss_limit) kprintf("%u\n", set->rss_limit);
+        else kprintf("none\n");
+    }
+}
+
 static void check_vmm();
 static size_t page_fault_count = 0;
 
+// page fault latency in tsc cycles, for each outcome
+static struct {
+    size_t count;
+    uint64_t cycles;
+    uint32_t max;
+    size_t hist[VMM_FAULT_NBUCKET]; // hist[i] counts latencies in [2^i, 2^(i + 1))
+} fault_stat[VMM_FAULT_NCAUSE];
+
+static const char *fault_cause_name[VMM_FAULT_NCAUSE] = {
+    [VMM_FAULT_ZERO]    "zero",
+    [VMM_FAULT_SWAP]    "swap",
+    [VMM_FAULT_PTALLOC] "ptalloc",
+    [VMM_FAULT_PERM]    "perm",
+    [VMM_FAULT_COW]     "cow",
+    [VMM_FAULT_MINOR]   "minor",
+    [VMM_FAULT_SPURIOUS] "spurious"
+};
+
 void vmm_init()
 {
     check_vmm();
@@ -145,8 +434,71 @@ size_t vmm_getPageFaultCount()
     return page_fault_count;
 }
 
+static void vmm_recordFault(vma_set_t *set, int cause, uint64_t cycles)
+{
+    // clamp very long faults(usually waiting for disk) to 32 bits
+    uint32_t lat = cycles >> 32 ? 0xffffffff : (uint32_t)cycles;
+    
+    fault_stat[cause].count++;
+    fault_stat[cause].cycles += cycles;
+    fault_stat[cause].hist[lat ? bsrl(lat) : 0]++;
+    
+    if (lat > fault_stat[cause].max) {
+        fault_stat[cause].max = lat;
+    }
+    
+    if (set) {
+        set->nfault[cause]++;
+        set->nactive++;
+    }
+}
+
+void vmm_resetFaultStat()
+{
+    no_intr_block(memset(fault_stat, 0, sizeof(fault_stat)));
+}
+
+// vmm_dumpFaultStat - print page fault latency histograms of all outcomes
+//                   - and the fault counters of set(if not NULL)
+void vmm_dumpFaultStat(vma_set_t *set)
+{
+    int i, j;
+    
+    kprintf("page fault: %u in total\n", page_fault_count);
+    
+    for (i = 0; i < VMM_FAULT_NCAUSE; i++) {
+        uint64_t avg = fault_stat[i].cycles;
+        
+        if (fault_stat[i].count) {
+            do_div(avg, fault_stat[i].count);
+        }
+        
+        kprintf(DBG_TAB "%-8s count %u, cycles %llu, avg %llu, max %u\n",
+                fault_cause_name[i], fault_stat[i].count,
+                fault_stat[i].cycles, avg, fault_stat[i].max);
+        
+        for (j = 0; j < VMM_FAULT_NBUCKET; j++) {
+            if (fault_stat[i].hist[j]) {
+                kprintf(DBG_TAB DBG_TAB "2^%-2d cycles: %u\n", j, fault_stat[i].hist[j]);
+            }
+        }
+    }
+    
+    if (set) {
+        kprintf("vma set %p:", set);
+        
+        for (i = 0; i < VMM_FAULT_NCAUSE; i++) {
+            kprintf(" %s %u", fault_cause_name[i], set->nfault[i]);
+        }
+        
+        kputc('\n');
+    }
+}
+
 int vmm_doPageFault(vma_set_t *set, uint32_t error, uintptr_t addr)
 {
+    uint64_t begin = rdtsc();
+    int cause = VMM_FAULT_PERM;
     int ret = -E_INVAL;
     
     // try to find a vma which include addr
@@ -195,15 +547,14 @@ int vmm_doPageFault(vma_set_t *set, uint32_t error, uintptr_t addr)
      *    continue process
      */
     
-    uint32_t perm = PTE_FLAG_U;
-    
-    if (vma->flags & VMA_FLAG_WRITE) {
-        perm |= PTE_FLAG_W;
-    }
+    uint32_t perm = vma_perm(vma);
     
     addr = ROUNDDOWN(addr, PAGE_SIZE);
 
     ret = -E_NO_MEM;
+    
+    cause = (set->pgdir[PD_INDEX(addr)] & PTE_FLAG_P) ?
+            VMM_FAULT_ZERO : VMM_FAULT_PTALLOC;
 
     pte_t *ptep = get_pte(set->pgdir, addr, true);
     
@@ -214,16 +565,53 @@ int vmm_doPageFault(vma_set_t *set, uint32_t error, uintptr_t addr)
         goto failed;
     }
     
-    if (*ptep == 0) { // if the phy addr doesn't exist, then alloc a page & map the phy addr with logical addr
+    if (*ptep & PTE_FLAG_P) { // present, a write to a shared page breaks the share
+        page_t *page = pte2page(*ptep);
+        
+        if (!(error & 2) || !page_isShared(page)) {
+            if ((error & 2) && !(*ptep & PTE_FLAG_W)) {
+                trace("vmm_doPageFault: write to read-only page at %p", (void *)addr);
+                cause = VMM_FAULT_PERM;
+                ret = -E_INVAL;
+                goto failed;
+            }
+            
+            // the pte allows it already, only the tlb is behind
+            tlb_invalidate(set->pgdir, addr);
+            cause = VMM_FAULT_SPURIOUS;
+            ret = 0;
+            goto failed;
+        }
+        
+        cause = VMM_FAULT_COW;
+        
+        if ((ret = ksm_breakShare(set, addr, ptep, perm, &page))) {
+            trace("vmm_doPageFault: failed to break share at %p", (void *)addr);
+            goto failed;
+        }
+        
+        vma_mapSwappable(set, addr, page, 0);
+    } else if (vma_reserveResident(set)) {
+        trace("vmm_doPageFault: rss limit reached and nothing to swap out");
+        goto failed;
+    } else if (*ptep == 0) { // if the phy addr doesn't exist, then alloc a page & map the phy addr with logical addr
         if (!pgdir_palloc(set->pgdir, addr, perm)) {
             trace("vmm_doPageFault: pgdir_alloc_page failed\n");
             goto failed;
         }
+        
+        set->nresident++;
     } else { // if this pte is a swap entry, then load data from disk to a page with phy addr
              // and call page_insert to map the phy addr with logical addr
         // NOTE: if a PTE is not present but non-zero, it's a swap entry
         // then you cast it to swap_entry_t
+        cause = VMM_FAULT_SWAP;
+        
         if(swap_hasInit()) {
+            if (*ptep == SWAP_ZERO_ENTRY || swap_cacheLookup(*ptep)) {
+                cause = VMM_FAULT_MINOR;
+            }
+            
             page_t *page = NULL;
             ret = swap_in(set, addr, &page);
             
@@ -236,8 +624,9 @@ int vmm_doPageFault(vma_set_t *set, uint32_t error, uintptr_t addr)
             swap_mapSwappable(set, addr, page, 1);
             
             page->pra_vaddr = addr;
+            set->nresident++;
         } else {
-            trace("vmm_doPageFault: swap not available(ptep = %x)", *ptep);
+            trace("vmm_doPageFault: swap not available(ptep = %llx)", (uint64_t)*ptep);
             goto failed;
         }
    }
@@ -245,6 +634,7 @@ int vmm_doPageFault(vma_set_t *set, uint32_t error, uintptr_t addr)
    ret = 0;
    
 failed:
+    vmm_recordFault(set, cause, rdtsc() - begin);
     return ret;
 }
 
@@ -321,6 +711,51 @@ static void check_vma_set()
     trace("check success: vma set");
 }
 
+static void check_vma_merge()
+{
+    size_t nfree = nfpage();
+    
+    vma_set_t *set = vma_set_new();
+    assert(set);
+    
+    vma_t *vma;
+    
+    // [0x1000, 0x2000) [0x3000, 0x4000)
+    vma = vma_set_insert(set, vma_new(0x1000, 0x2000, VMA_FLAG_READ));
+    assert(vma->start == 0x1000 && vma->end == 0x2000);
+    vma = vma_set_insert(set, vma_new(0x3000, 0x4000, VMA_FLAG_READ));
+    assert(set->mcount == 2);
+    
+    // grow prev: [0x1000, 0x2800) [0x3000, 0x4000)
+    vma = vma_set_insert(set, vma_new(0x2000, 0x2800, VMA_FLAG_READ));
+    assert(vma->start == 0x1000 && vma->end == 0x2800);
+    assert(set->mcount == 2);
+    
+    // grow next: [0x1000, 0x2800) [0x2c00, 0x4000)
+    vma = vma_set_insert(set, vma_new(0x2c00, 0x3000, VMA_FLAG_READ));
+    assert(vma->start == 0x2c00 && vma->end == 0x4000);
+    assert(set->mcount == 2);
+    
+    // bridge the two: [0x1000, 0x4000)
+    assert(vma_set_find(set, 0x3000)->start == 0x2c00);
+    
+    vma = vma_set_insert(set, vma_new(0x2800, 0x2c00, VMA_FLAG_READ));
+    assert(vma->start == 0x1000 && vma->end == 0x4000);
+    assert(set->mcount == 1);
+    assert(vma_set_find(set, 0x3000) == vma);
+    
+    // different flags: [0x1000, 0x4000) [0x4000, 0x5000)
+    vma = vma_set_insert(set, vma_new(0x4000, 0x5000, VMA_FLAG_WRITE));
+    assert(vma->start == 0x4000 && vma->end == 0x5000);
+    assert(set->mcount == 2);
+    
+    vma_set_free(set);
+    
+    assert(nfree == nfpage());
+    
+    trace("check success: vma merge");
+}
+
 vma_set_t *c0re_check_vma_set = NULL;
 
 static void check_pgfault()
@@ -338,7 +773,7 @@ static void check_pgfault()
     vma_t *vma = vma_new(0, PT_SIZE, VMA_FLAG_WRITE);
     assert(vma);
 
-    vma_set_insert(set, vma);
+    vma = vma_set_insert(set, vma);
 
     uintptr_t addr = 0x0;
     assert(vma_set_find(set, addr) == vma);
@@ -356,7 +791,7 @@ static void check_pgfault()
     
     assert(sum == 0);
 
-    page_remove(pgdir, ROUNDDOWN(addr, PAGE_SIZE));
+    vma_set_unmap(set, ROUNDDOWN(addr, PAGE_SIZE));
     pfree(pde2page(pgdir[0]));
     
     pgdir[0] = 0;
@@ -371,13 +806,183 @@ static void check_pgfault()
     trace("check success: page fault");
 }
 
+extern free_area_t free_area, high_area;
+
+// populate npage pages of set with CHECK_POPULATE_NFRAME frames, the page table
+// is there already
+#define CHECK_POPULATE_NFRAME 3
+
+static void check_populateShort(vma_set_t *set, int npage)
+{
+    page_t *block = palloc(CHECK_POPULATE_NFRAME);
+    int i;
+    
+    assert(block);
+    
+    for (i = 0; i < CHECK_POPULATE_NFRAME; i++) {
+        block[i].nfree = 1;
+    }
+    
+    free_area_t low = free_area, high = high_area;
+    
+    free_area.freed = high_area.freed = NULL;
+    free_area.nfree = high_area.nfree = 0;
+    
+    for (i = 0; i < CHECK_POPULATE_NFRAME; i++) {
+        pfree(block + i);
+    }
+    
+    assert(nfpage() == CHECK_POPULATE_NFRAME);
+    
+    // the pages that got a frame are mapped, and nothing is kept
+    assert(vma_populate(set, 0, npage * PAGE_SIZE, false) == CHECK_POPULATE_NFRAME);
+    assert(set->nresident == CHECK_POPULATE_NFRAME && nfpage() == 0);
+    
+    for (i = 0; i < npage; i++) {
+        assert(!get_page(set->pgdir, i * PAGE_SIZE, NULL) == (i >= CHECK_POPULATE_NFRAME));
+        vma_set_unmap(set, i * PAGE_SIZE);
+    }
+    
+    // the rss limit stops it with a page of the batch left, which is given back
+    vma_set_setRSSLimit(set, CHECK_POPULATE_NFRAME - 1);
+    
+    assert(vma_populate(set, 0, npage * PAGE_SIZE, false) == CHECK_POPULATE_NFRAME - 1);
+    assert(nfpage() == 1);
+    
+    vma_set_setRSSLimit(set, 0);
+    
+    for (i = 0; i < npage; i++) {
+        vma_set_unmap(set, i * PAGE_SIZE);
+    }
+    
+    assert(nfpage() == CHECK_POPULATE_NFRAME);
+    
+    // take the frames back before the free lists are
+    page_t *frames[CHECK_POPULATE_NFRAME];
+    
+    for (i = 0; i < CHECK_POPULATE_NFRAME; i++) {
+        assert((frames[i] = palloc(1)));
+    }
+    
+    free_area = low;
+    high_area = high;
+    
+    for (i = 0; i < CHECK_POPULATE_NFRAME; i++) {
+        pfree(frames[i]);
+    }
+}
+
+static void check_populate()
+{
+    size_t nfree = nfpage();
+    
+    vma_set_t *set = c0re_check_vma_set = vma_set_new();
+    pde_t *pgdir = set->pgdir = c0re_pgdir;
+    
+    assert(set);
+    assert(pgdir[0] == 0);
+    
+    int npage = VMA_POPULATE_BATCH + 8, i;
+    
+    vma_t *vma = vma_new(0, npage * PAGE_SIZE, VMA_FLAG_READ);
+    assert(vma);
+    vma = vma_set_insert(set, vma);
+    
+    size_t base = nfpage();
+    
+    // read-only or out of range
+    assert(vma_populate(set, 0, PAGE_SIZE, true) == -E_INVAL);
+    assert(vma_populate(set, 0, (npage + 1) * PAGE_SIZE, false) == -E_INVAL);
+    assert(base == nfpage());
+    
+    // one page table + npage pages
+    assert(vma_populate(set, 0, npage * PAGE_SIZE, false) == npage);
+    assert(nfpage() == base - npage - 1);
+    
+    // populate again should do nothing
+    assert(vma_populate(set, PAGE_SIZE, 3 * PAGE_SIZE, false) == 2);
+    assert(nfpage() == base - npage - 1);
+    
+    size_t init = vmm_getPageFaultCount();
+    
+    for (i = 0; i < npage; i++) {
+        assert(get_page(pgdir, i * PAGE_SIZE, NULL));
+        (void)*(volatile char *)(i * PAGE_SIZE);
+    }
+    
+    assert(vmm_getPageFaultCount() == init);
+    
+    for (i = 0; i < npage; i++) {
+        vma_set_unmap(set, i * PAGE_SIZE);
+    }
+    
+    // out of memory halfway, with only a few frames left
+    check_populateShort(set, npage);
+    
+    pfree(pde2page(pgdir[0]));
+    pgdir[0] = 0;
+    
+    set->pgdir = NULL;
+    vma_set_free(set);
+    
+    c0re_check_vma_set = NULL;
+    
+    assert(nfree == nfpage());
+    
+    trace("check success: populate");
+}
+
+static void check_rss()
+{
+    size_t nfree = nfpage();
+    
+    vma_set_t *set = c0re_check_vma_set = vma_set_new();
+    pde_t *pgdir = set->pgdir = c0re_pgdir;
+    
+    assert(set);
+    assert(pgdir[0] == 0);
+    
+    vma_set_insert(set, vma_new(0, 4 * PAGE_SIZE, VMA_FLAG_READ));
+    vma_set_setRSSLimit(set, 2);
+    
+    // swap is not ready, so pages over the limit cannot be mapped
+    assert(vma_populate(set, 0, 4 * PAGE_SIZE, false) == 2);
+    assert(set->nresident == 2 && set->nswapped == 0);
+    
+    vma_set_setRSSLimit(set, 0);
+    
+    assert(vma_populate(set, 0, 4 * PAGE_SIZE, false) == 4);
+    assert(set->nresident == 4);
+    
+    int i;
+    
+    for (i = 0; i < 4; i++) {
+        vma_set_unmap(set, i * PAGE_SIZE);
+    }
+    
+    pfree(pde2page(pgdir[0]));
+    pgdir[0] = 0;
+    
+    set->pgdir = NULL;
+    vma_set_free(set);
+    
+    c0re_check_vma_set = NULL;
+    
+    assert(nfree == nfpage());
+    
+    trace("check success: rss");
+}
+
 // check_vmm - check correctness of vmm
 static void check_vmm()
 {
     size_t nfree = nfpage();
     
     check_vma_set();
+    check_vma_merge();
     check_pgfault();
+    check_populate();
+    check_rss();
 
     assert(nfree == nfpage());
 
@@ -11,6 +11,18 @@
 
 struct vma_set_t_tag;
 
+/* page fault outcomes */
+#define VMM_FAULT_ZERO          0 // mapped a new page
+#define VMM_FAULT_SWAP          1 // swapped in a page
+#define VMM_FAULT_PTALLOC       2 // a page table was allocated
+#define VMM_FAULT_PERM          3 // access not allowed
+#define VMM_FAULT_COW           4 // write to a shared page
+#define VMM_FAULT_MINOR         5 // got a page back from the swap cache
+#define VMM_FAULT_SPURIOUS      6 // the pte was fine, only the tlb was stale
+#define VMM_FAULT_NCAUSE        7
+
+#define VMM_FAULT_NBUCKET       32 // one bucket for each power of 2 tsc cycles
+
 typedef struct {
     struct vma_set_t_tag *set;
     
@@ -22,6 +34,8 @@ typedef struct {
 } vma_t;
 
 typedef struct vma_set_t_tag {
+    dllist_t link;              // in the list of all vma sets
+    
     dllist_t mset;
     vma_t *mcache;
     size_t mcount;
@@ -29,10 +43,20 @@ typedef struct vma_set_t_tag {
     pde_t *pgdir;
     
     void *swap_data;
+    
+    size_t nfault[VMM_FAULT_NCAUSE]; // page fault count of each outcome
+    
+    size_t nresident;           // # of pages mapped
+    size_t nswapped;            // # of pages swapped out
+    size_t rss_limit;           // max nresident, 0 for no limit
+    size_t nactive;             // page faults lately, decays in background reclaim
 } vma_set_t;
 
 #define dll2vma(dll, member) \
     to_struct((dll), vma_t, member)
+
+#define dll2vmaset(dll, member) \
+    to_struct((dll), vma_set_t, member)
     
 #define VMA_FLAG_READ           0x00000001
 #define VMA_FLAG_WRITE          0x00000002
@@ -42,11 +66,19 @@ vma_t *vma_new(uintptr_t start, uintptr_t end, uint32_t flags);
 
 vma_set_t *vma_set_new();
 void vma_set_free(vma_set_t *set);
-void vma_set_insert(vma_set_t *set, vma_t *vma);
+vma_set_t *vma_set_next(vma_set_t *set);
+void vma_set_setRSSLimit(vma_set_t *set, size_t npage);
+void vma_set_unmap(vma_set_t *set, uintptr_t addr);
+vma_t *vma_set_insert(vma_set_t *set, vma_t *vma);
 vma_t *vma_set_find(vma_set_t *set, uintptr_t addr);
+int vma_populate(vma_set_t *set, uintptr_t start, uintptr_t end, bool write);
 
 void vmm_init();
 int vmm_doPageFault(vma_set_t *set, uint32_t error, uintptr_t addr);
 size_t vmm_getPageFaultCount();
 
+void vmm_dumpFaultStat(vma_set_t *set);
+void vmm_resetFaultStat();
+void vmm_dumpSetStat();
+
 #endif
@@ -24,6 +24,7 @@
 
 #define C0RE_NOINLINE __attribute__((noinline))
 #define C0RE_NORETURN __attribute__((noreturn))
+#define C0RE_ALIGNED(n) __attribute__((aligned(n)))
 
 typedef int bool;
 
@@ -0,0 +1,212 @@
+#include "pub/lz.h"
+#include "pub/string.h"
+
+/**
+ * the output is a list of sequences, each one made of
+ *
+ *     token | literal length+ | literals | offset(2 bytes) | match length+
+ *
+ * the high 4 bits of the token are the # of literals, the low 4 bits the
+ * match length minus LZ_MIN_MATCH. a nibble of 15 is followed by more
+ * bytes that are added to it until one of them isn't 255. the match is
+ * copied from offset bytes back in the output. the last sequence has
+ * literals only and ends the input.
+ **/
+
+C0RE_INLINE
+uint32_t lz_read32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+C0RE_INLINE
+uint32_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// store the part of len over a token nibble
+// return value: the new output position, NULL if out of room
+static uint8_t *lz_putLen(uint8_t *op, uint8_t *oend, size_t len)
+{
+    for (; len >= 255; len -= 255) {
+        if (op == oend) {
+            return NULL;
+        }
+    
+        *op++ = 255;
+    }
+    
+    if (op == oend) {
+        return NULL;
+    }
+    
+    *op++ = len;
+    
+    return op;
+}
+
+// store one sequence, mlen is 0 for the last one
+// return value: the new output position, NULL if out of room
+static uint8_t *lz_putSeq(uint8_t *op, uint8_t *oend, const uint8_t *lit, size_t nlit,
+                          size_t off, size_t mlen)
+{
+    uint8_t *token = op;
+    
+    if (op == oend) {
+        return NULL;
+    }
+    
+    op++;
+    *token = (nlit < 15 ? nlit : 15) << 4;
+    
+    if (nlit >= 15 && !(op = lz_putLen(op, oend, nlit - 15))) {
+        return NULL;
+    }
+    
+    if ((size_t)(oend - op) < nlit) {
+        return NULL;
+    }
+    
+    memcpy(op, lit, nlit);
+    op += nlit;
+    
+    if (!mlen) {
+        return op;
+    }
+    
+    if (oend - op < 2) {
+        return NULL;
+    }
+    
+    *op++ = off & 0xFF;
+    *op++ = off >> 8;
+    
+    mlen -= LZ_MIN_MATCH;
+    *token |= mlen < 15 ? mlen : 15;
+    
+    if (mlen >= 15 && !(op = lz_putLen(op, oend, mlen - 15))) {
+        return NULL;
+    }
+    
+    return op;
+}
+
+// lz_compress - compress n bytes of src into dst
+// return value: the compressed size, 0 if it's more than cap
+size_t lz_compress(const void *src, size_t n, void *dst, size_t cap, uint16_t *table)
+{
+    const uint8_t *in = src, *ip = in, *anchor = in, *end = in + n;
+    uint8_t *op = dst, *oend = op + cap;
+    
+    if (n > LZ_MAX_INPUT) {
+        return 0;
+    }
+    
+    memset(table, 0, LZ_HASH_SIZE * sizeof(*table));
+    
+    while (end - ip >= LZ_MIN_MATCH) {
+        uint32_t v = lz_read32(ip), h = lz_hash(v);
+        const uint8_t *ref = in + table[h];
+    
+        table[h] = ip - in;
+    
+        if (ref >= ip || lz_read32(ref) != v) {
+            ip++;
+            continue;
+        }
+    
+        const uint8_t *mp = ip + LZ_MIN_MATCH, *rp = ref + LZ_MIN_MATCH;
+    
+        while (mp < end && *mp == *rp) {
+            mp++;
+            rp++;
+        }
+    
+        if (!(op = lz_putSeq(op, oend, anchor, ip - anchor, ip - ref, mp - ip))) {
+            return 0;
+        }
+    
+        ip = anchor = mp;
+    }
+    
+    if (!(op = lz_putSeq(op, oend, anchor, end - anchor, 0, 0))) {
+        return 0;
+    }
+    
+    return op - (uint8_t *)dst;
+}
+
+// get the part of a length over a token nibble
+// return value: the new input position, NULL if the input is cut
+static const uint8_t *lz_getLen(const uint8_t *ip, const uint8_t *iend, size_t *len)
+{
+    uint8_t b;
+    
+    do {
+        if (ip == iend) {
+            return NULL;
+        }
+    
+        b = *ip++;
+        *len += b;
+    } while (b == 255);
+    
+    return ip;
+}
+
+// lz_decompress - decompress n bytes of src into dst
+// return value: the decompressed size, 0 if the input is corrupt
+//               or doesn't fit in cap
+size_t lz_decompress(const void *src, size_t n, void *dst, size_t cap)
+{
+    const uint8_t *ip = src, *iend = ip + n;
+    uint8_t *out = dst, *op = out, *oend = op + cap;
+    
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t nlit = token >> 4, mlen = token & 15, off;
+    
+        if (nlit == 15 && !(ip = lz_getLen(ip, iend, &nlit))) {
+            return 0;
+        }
+    
+        if ((size_t)(iend - ip) < nlit || (size_t)(oend - op) < nlit) {
+            return 0;
+        }
+    
+        memcpy(op, ip, nlit);
+        ip += nlit;
+        op += nlit;
+    
+        if (ip == iend) {
+            break;
+        }
+    
+        if (iend - ip < 2) {
+            return 0;
+        }
+    
+        off = ip[0] | (ip[1] << 8);
+        ip += 2;
+    
+        if (mlen == 15 && !(ip = lz_getLen(ip, iend, &mlen))) {
+            return 0;
+        }
+    
+        mlen += LZ_MIN_MATCH;
+    
+        if (!off || off > (size_t)(op - out) || (size_t)(oend - op) < mlen) {
+            return 0;
+        }
+    
+        // byte by byte, the match may overlap what it produces
+        const uint8_t *ref = op - off;
+    
+        while (mlen--) {
+            *op++ = *ref++;
+        }
+    }
+    
+    return op - out;
+}
@@ -0,0 +1,18 @@
+#ifndef _PUB_LZ_H_
+#define _PUB_LZ_H_
+
+/* a small lz77 compressor in the lz4 block format */
+
+#include "pub/com.h"
+
+#define LZ_HASH_BITS    12
+#define LZ_HASH_SIZE    (1 << LZ_HASH_BITS)
+
+#define LZ_MIN_MATCH    4
+#define LZ_MAX_INPUT    0xFFFF // positions are kept in 16 bits
+
+// table: LZ_HASH_SIZE entries of scratch space for the match finder
+size_t lz_compress(const void *src, size_t n, void *dst, size_t cap, uint16_t *table);
+size_t lz_decompress(const void *src, size_t n, void *dst, size_t cap);
+
+#endif
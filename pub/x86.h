@@ -20,9 +20,11 @@
     })
 
 C0RE_INLINE uint8_t inb(uint16_t port);
+C0RE_INLINE uint32_t inl(uint16_t port);
 C0RE_INLINE void insl(uint32_t port, void *addr, int cnt);
 C0RE_INLINE void outb(uint16_t port, uint8_t data);
 C0RE_INLINE void outw(uint16_t port, uint16_t data);
+C0RE_INLINE void outl(uint16_t port, uint32_t data);
 C0RE_INLINE void outsl(uint32_t port, const void *addr, int cnt);
 C0RE_INLINE uint32_t read_ebp(void);
 
@@ -41,10 +43,12 @@ C0RE_INLINE uint32_t read_eflags();
 C0RE_INLINE void write_eflags(uint32_t eflags); 
 C0RE_INLINE void lcr0(uintptr_t cr0); 
 C0RE_INLINE void lcr3(uintptr_t cr3); 
+C0RE_INLINE void lcr4(uintptr_t cr4); 
 C0RE_INLINE uintptr_t rcr0(); 
 C0RE_INLINE uintptr_t rcr1(); 
 C0RE_INLINE uintptr_t rcr2(); 
 C0RE_INLINE uintptr_t rcr3(); 
+C0RE_INLINE uintptr_t rcr4(); 
 C0RE_INLINE void invlpg(void *addr); 
 
 C0RE_INLINE void breakpoint(void);
@@ -53,6 +57,9 @@ C0RE_INLINE void write_dr(unsigned regnum, uint32_t value);
 
 C0RE_INLINE void hlt();
 
+C0RE_INLINE uint64_t rdtsc();
+C0RE_INLINE int bsrl(uint32_t val);
+
 /* INPUT byte */
 C0RE_INLINE
 uint8_t inb(uint16_t port)
@@ -62,6 +69,15 @@ uint8_t inb(uint16_t port)
     return data;
 }
 
+/* INPUT int */
+C0RE_INLINE
+uint32_t inl(uint16_t port)
+{
+    uint32_t data;
+    asm volatile ("inl %1, %0" : "=a" (data) : "d" (port));
+    return data;
+}
+
 /* INPUT int string */
 C0RE_INLINE
 void insl(uint32_t port, void *addr, int cnt)
@@ -89,6 +105,13 @@ void outw(uint16_t port, uint16_t data)
     asm volatile ("outw %0, %1" :: "a" (data), "d" (port));
 }
 
+/* OUTPUT int */
+C0RE_INLINE
+void outl(uint16_t port, uint32_t data)
+{
+    asm volatile ("outl %0, %1" :: "a" (data), "d" (port));
+}
+
 C0RE_INLINE
 void outsl(uint32_t port, const void *addr, int cnt)
 {
@@ -196,6 +219,12 @@ void lcr3(uintptr_t cr3)
     asm volatile ("mov %0, %%cr3" :: "r" (cr3) : "memory");
 }
 
+C0RE_INLINE
+void lcr4(uintptr_t cr4)
+{
+    asm volatile ("mov %0, %%cr4" :: "r" (cr4) : "memory");
+}
+
 C0RE_INLINE
 uintptr_t rcr0()
 {
@@ -228,6 +257,14 @@ uintptr_t rcr3()
     return cr3;
 }
 
+C0RE_INLINE
+uintptr_t rcr4()
+{
+    uintptr_t cr4;
+    asm volatile ("mov %%cr4, %0" : "=r" (cr4) :: "memory");
+    return cr4;
+}
+
 C0RE_INLINE
 void invlpg(void *addr)
 {
@@ -240,6 +277,24 @@ void hlt()
     asm volatile ("hlt");
 }
 
+/* read time-stamp counter */
+C0RE_INLINE
+uint64_t rdtsc()
+{
+    uint64_t tsc;
+    asm volatile ("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
+/* index of the most significant set bit(val must not be 0) */
+C0RE_INLINE
+int bsrl(uint32_t val)
+{
+    int idx;
+    asm ("bsrl %1, %0" : "=r" (idx) : "rm" (val) : "cc");
+    return idx;
+}
+
 C0RE_INLINE int __strcmp(const char *s1, const char *s2);
 C0RE_INLINE char *__strcpy(char *dst, const char *src);
 C0RE_INLINE void *__memset(void *s, char c, size_t n);
@@ -0,0 +1,137 @@
+#include "pub/com.h"
+#include "pub/string.h"
+
+#include "swapsim.h"
+
+/**
+ * synthetic traces over npage pages, SIM_WRITE_PERCENT of the accesses
+ * are writes:
+ *
+ *     loop:  0, 1, ..., npage - 1, 0, 1, ...
+ *     zipf:  page of rank i is picked with a weight of 1/i, the ranks are
+ *            shuffled over the pages
+ *     scan:  half of the accesses go to a random page of a hot set of
+ *            npage/8 pages, the others scan the rest of the pages in order
+ **/
+
+#define GEN_ZIPF_SCALE  (1 << 24) // weight of the first rank
+
+static uint32_t gen_seed;
+
+// xorshift32, never 0
+static uint32_t gen_rand()
+{
+    gen_seed ^= gen_seed << 13;
+    gen_seed ^= gen_seed >> 17;
+    gen_seed ^= gen_seed << 5;
+    
+    return gen_seed;
+}
+
+C0RE_INLINE
+bool gen_isWrite()
+{
+    return gen_rand() % 100 < SIM_WRITE_PERCENT;
+}
+
+static void gen_loop(sim_trace_t *trace)
+{
+    size_t i;
+    
+    for (i = 0; i < trace->hdr.naccess; i++) {
+        trace->rec[i] = SIM_REC(i % trace->hdr.npage, gen_isWrite());
+    }
+}
+
+static void gen_zipf(sim_trace_t *trace)
+{
+    size_t npage = trace->hdr.npage, i, lo, hi;
+    uint32_t *cdf = host_alloc(npage * sizeof(*cdf));
+    uint32_t *perm = host_alloc(npage * sizeof(*perm));
+    uint32_t total = 0, u;
+    
+    // sum of 2^24/i stays below 2^32 for any npage that fits in memory
+    for (i = 0; i < npage; i++) {
+        total += GEN_ZIPF_SCALE / (i + 1);
+        cdf[i] = total;
+        perm[i] = i;
+    }
+    
+    for (i = npage - 1; i > 0; i--) {
+        size_t j = gen_rand() % (i + 1);
+        uint32_t tmp = perm[i];
+    
+        perm[i] = perm[j];
+        perm[j] = tmp;
+    }
+    
+    for (i = 0; i < trace->hdr.naccess; i++) {
+        u = gen_rand() % total;
+    
+        // the first rank whose cdf is over u
+        for (lo = 0, hi = npage - 1; lo < hi; ) {
+            size_t mid = (lo + hi) / 2;
+    
+            if (cdf[mid] > u) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+    
+        trace->rec[i] = SIM_REC(perm[lo], gen_isWrite());
+    }
+}
+
+static void gen_scan(sim_trace_t *trace)
+{
+    size_t npage = trace->hdr.npage, nhot = npage / 8, cold = nhot, i;
+    
+    for (i = 0; i < trace->hdr.naccess; i++) {
+        if (gen_rand() & 1) {
+            trace->rec[i] = SIM_REC(gen_rand() % nhot, gen_isWrite());
+        } else {
+            trace->rec[i] = SIM_REC(cold, gen_isWrite());
+    
+            if (++cold == npage) {
+                cold = nhot;
+            }
+        }
+    }
+}
+
+// sim_gen - fill trace with naccess accesses to npage pages following pattern
+// return value: 0 on success, -1 for an unknown pattern
+int sim_gen(sim_trace_t *trace, const char *pattern, size_t npage, size_t naccess)
+{
+    static const struct {
+        const char *name;
+        void (*gen)(sim_trace_t *);
+    } gens[] = {
+        { "loop", gen_loop },
+        { "zipf", gen_zipf },
+        { "scan", gen_scan },
+    };
+    size_t i;
+    
+    if (npage < 8 || !naccess) {
+        return -1;
+    }
+    
+    for (i = 0; i < C0RE_ARRLEN(gens); i++) {
+        if (strcmp(pattern, gens[i].name) == 0) {
+            trace->hdr.magic = SIM_TRACE_MAGIC;
+            trace->hdr.npage = npage;
+            trace->hdr.naccess = naccess;
+            trace->rec = host_alloc(naccess * sizeof(*trace->rec));
+    
+            // the same trace every time
+            gen_seed = 2463534242U;
+            gens[i].gen(trace);
+    
+            return 0;
+        }
+    }
+    
+    return -1;
+}
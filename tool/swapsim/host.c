@@ -0,0 +1,190 @@
+#include "pub/com.h"
+#include "pub/printfmt.h"
+#include "pub/string.h"
+
+#include "swapsim.h"
+
+/**
+ * there is no libc for i386 on most hosts, so the simulator talks to
+ * linux through int 0x80 itself. the heap is a bump allocator on top of
+ * brk, released back to a mark between two runs.
+ **/
+
+#define SYS_EXIT        1
+#define SYS_READ        3
+#define SYS_WRITE       4
+#define SYS_OPEN        5
+#define SYS_CLOSE       6
+#define SYS_LSEEK       19
+#define SYS_BRK         45
+
+#define HOST_SEEK_SET   0
+#define HOST_SEEK_END   2
+
+#define HOST_OUT_SIZE   1024
+
+int main(int argc, char **argv);
+
+static int host_syscall(int no, int a, int b, int c)
+{
+    int ret;
+    
+    asm volatile ("int $0x80"
+                  : "=a" (ret)
+                  : "a" (no), "b" (a), "c" (b), "d" (c)
+                  : "memory");
+    
+    return ret;
+}
+
+static char host_out[HOST_OUT_SIZE];
+static size_t host_nout = 0;
+
+static void host_flush()
+{
+    if (host_nout) {
+        host_write(1, host_out, host_nout);
+        host_nout = 0;
+    }
+}
+
+void host_exit(int code)
+{
+    host_flush();
+    
+    while (1) {
+        host_syscall(SYS_EXIT, code, 0, 0);
+    }
+}
+
+int host_open(const char *path, int flags, int mode)
+{
+    return host_syscall(SYS_OPEN, (int)path, flags, mode);
+}
+
+int host_close(int fd)
+{
+    return host_syscall(SYS_CLOSE, fd, 0, 0);
+}
+
+// read or write all n bytes, or fail
+static int host_io(int no, int fd, void *buf, size_t n)
+{
+    size_t done = 0;
+    int ret;
+    
+    while (done < n) {
+        if ((ret = host_syscall(no, fd, (int)buf + done, n - done)) <= 0) {
+            return -1;
+        }
+    
+        done += ret;
+    }
+    
+    return done;
+}
+
+int host_read(int fd, void *buf, size_t n)
+{
+    return host_io(SYS_READ, fd, buf, n);
+}
+
+int host_write(int fd, const void *buf, size_t n)
+{
+    return host_io(SYS_WRITE, fd, (void *)buf, n);
+}
+
+// host_size - size of the file open at fd, the offset goes back to 0
+int host_size(int fd)
+{
+    int size = host_syscall(SYS_LSEEK, fd, 0, HOST_SEEK_END);
+    
+    host_syscall(SYS_LSEEK, fd, 0, HOST_SEEK_SET);
+    
+    return size;
+}
+
+static uintptr_t host_brk = 0, host_top = 0;
+
+// host_alloc - n bytes of zeroed memory, exits when there is none left
+void *host_alloc(size_t n)
+{
+    uintptr_t ptr, end;
+    
+    if (!host_brk) {
+        host_brk = host_top = host_syscall(SYS_BRK, 0, 0, 0);
+    }
+    
+    ptr = ROUNDUP(host_brk, 16);
+    end = ptr + n;
+    
+    if (end > host_top) {
+        // brk returns the old break when it fails
+        uintptr_t top = ROUNDUP(end, 1 << 20);
+    
+        if ((uintptr_t)host_syscall(SYS_BRK, top, 0, 0) != top) {
+            host_printf("swapsim: out of memory for %d bytes\n", n);
+            host_exit(1);
+        }
+    
+        host_top = top;
+    }
+    
+    host_brk = end;
+    memset((void *)ptr, 0, n);
+    
+    return (void *)ptr;
+}
+
+void *host_mark()
+{
+    return (void *)host_brk;
+}
+
+// host_release - give back everything allocated after mark
+void host_release(void *mark)
+{
+    host_brk = (uintptr_t)mark;
+}
+
+static void host_putc(int c, void *unused)
+{
+    host_out[host_nout++] = c;
+    
+    if (host_nout == HOST_OUT_SIZE || c == '\n') {
+        host_flush();
+    }
+}
+
+int host_vprintf(const char *fmt, va_list ap)
+{
+    vprintfmt(host_putc, NULL, fmt, ap);
+    return 0;
+}
+
+int host_printf(const char *fmt, ...)
+{
+    va_list ap;
+    
+    va_start(ap, fmt);
+    host_vprintf(fmt, ap);
+    va_end(ap);
+    
+    return 0;
+}
+
+// entered from _start with the initial stack: argc, then argv
+void host_start(uint32_t *sp)
+{
+    host_exit(main(sp[0], (char **)(sp + 1)));
+}
+
+asm (".text\n"
+     ".globl _start\n"
+     "_start:\n"
+     "    xorl %ebp, %ebp\n"
+     "    movl %esp, %eax\n"
+     "    andl $-16, %esp\n"
+     "    subl $12, %esp\n"
+     "    pushl %eax\n"
+     "    call host_start\n");
@@ -0,0 +1,450 @@
+#include "pub/com.h"
+#include "pub/dllist.h"
+#include "pub/string.h"
+#include "pub/printfmt.h"
+#include "pub/x86.h"
+
+#include "lib/debug.h"
+
+#include "mem/swap.h"
+#include "mem/smfifo.h"
+#include "mem/smclock.h"
+#include "mem/smarc.h"
+#include "mem/smmglru.h"
+
+#include "swapsim.h"
+
+/**
+ * the kernel around the swap managers is simulated: one vma set over the
+ * traced pages, a page table, nframe frames and a swap device that only
+ * remembers which pages have a copy on it. an access sets PTE_FLAG_A(and
+ * PTE_FLAG_D for a write) like the mmu, a fault on a page with no frame
+ * takes the victim the manager chooses when all frames are used. the
+ * victim is written if it's dirty or has no copy on the device yet.
+ *
+ * there is no tlb, so swap_flush has nothing to do.
+ **/
+
+#define SIM_BASE            PT_SIZE     // where the traced pages start
+#define SIM_DEFAULT_NPAGE   4096
+#define SIM_DEFAULT_NACCESS (1 << 18)
+#define SIM_DEFAULT_TICK    4096        // accesses between two ticks
+
+static swap_manager_t *sim_mans[] = {
+    &swap_manager_fifo,
+    &swap_manager_clock,
+    &swap_manager_arc,
+    &swap_manager_mglru,
+};
+
+typedef struct {
+    size_t nfault;          // all page faults
+    size_t nread;           // pages read from the device
+    size_t nwrite;          // pages written to it
+    uint64_t ncycle;        // tsc cycles spent in the manager
+} sim_stat_t;
+
+/* what the managers use from the kernel */
+
+page_t *c0re_pages;
+size_t c0re_npage, c0re_npage_low;
+
+static pte_t *sim_pt[PD_NENTRY];
+static pde_t sim_pgdir[PD_NENTRY];
+
+static page_t **sim_free;           // stack of free frames
+static size_t sim_nfree;
+
+static uint8_t *sim_disk;           // whether each page has a copy on the device
+static sim_stat_t sim_stat;
+static bool sim_verbose = 0;
+
+int kprintf(const char *fmt, ...)
+{
+    va_list ap;
+    
+    if (sim_verbose) {
+        va_start(ap, fmt);
+        host_vprintf(fmt, ap);
+        va_end(ap);
+    }
+    
+    return 0;
+}
+
+void cons_putc(int c)
+{
+    if (sim_verbose) {
+        host_printf("%c", c);
+    }
+}
+
+void _panic(char *file, int line, const char *fmt, ...)
+{
+    va_list ap;
+    
+    host_printf("swapsim: panic at %s:%d: ", file, line);
+    
+    va_start(ap, fmt);
+    host_vprintf(fmt, ap);
+    va_end(ap);
+    
+    host_printf("\n");
+    host_exit(2);
+}
+
+void *kmalloc(size_t n)
+{
+    return host_alloc(n);
+}
+
+void kfree(void *ptr, size_t n)
+{
+}
+
+pte_t *get_pte(pde_t *pgdir, uintptr_t la, bool create)
+{
+    size_t pdx = PD_INDEX(la);
+    
+    if (!sim_pt[pdx]) {
+        if (!create) {
+            return NULL;
+        }
+    
+        sim_pt[pdx] = host_alloc(PT_NENTRY * sizeof(pte_t));
+        pgdir[pdx] = PTE_FLAG_USER;
+    }
+    
+    return &sim_pt[pdx][PT_INDEX(la)];
+}
+
+page_t *get_page(pde_t *pgdir, uintptr_t la, pte_t **ptep_result)
+{
+    pte_t *ptep = get_pte(pgdir, la, 0);
+    
+    if (ptep_result) {
+        *ptep_result = ptep;
+    }
+    
+    return ptep && (*ptep & PTE_FLAG_P) ? pte2page(*ptep) : NULL;
+}
+
+bool swap_clearRef(vma_set_t *set, page_t *page, swap_flush_t *flush)
+{
+    pte_t *ptep = get_pte(set->pgdir, page->pra_vaddr, 0);
+    
+    assert(ptep && (*ptep & PTE_FLAG_P));
+    
+    return swap_clearPteRef(ptep, page->pra_vaddr, flush);
+}
+
+bool swap_clearPteRef(pte_t *ptep, uintptr_t addr, swap_flush_t *flush)
+{
+    if (!(*ptep & PTE_FLAG_A)) {
+        return 0;
+    }
+    
+    *ptep &= ~PTE_FLAG_A;
+    
+    return 1;
+}
+
+void swap_flush(vma_set_t *set, swap_flush_t *flush)
+{
+    flush->n = 0;
+}
+
+size_t vmm_getPageFaultCount()
+{
+    return sim_stat.nfault;
+}
+
+/* the simulated machine */
+
+static void sim_setup(vma_set_t *set, vma_t *vma, size_t npage, size_t nframe)
+{
+    size_t i;
+    
+    memset(sim_pt, 0, sizeof(sim_pt));
+    memset(sim_pgdir, 0, sizeof(sim_pgdir));
+    memset(&sim_stat, 0, sizeof(sim_stat));
+    
+    c0re_npage = c0re_npage_low = nframe;
+    c0re_pages = host_alloc(nframe * sizeof(page_t));
+    
+    sim_free = host_alloc(nframe * sizeof(page_t *));
+    sim_nfree = nframe;
+    
+    for (i = 0; i < nframe; i++) {
+        sim_free[i] = &c0re_pages[nframe - 1 - i];
+    }
+    
+    sim_disk = host_alloc(npage);
+    
+    memset(set, 0, sizeof(*set));
+    dllist_init(&(set->mset));
+    set->pgdir = sim_pgdir;
+    
+    vma->set = set;
+    vma->start = SIM_BASE;
+    vma->end = SIM_BASE + npage * PAGE_SIZE;
+    vma->flags = VMA_FLAG_READ | VMA_FLAG_WRITE;
+    dllist_add(&(set->mset), &(vma->link));
+}
+
+// give the frame of the victim back, writing it first if needed
+static void sim_evict(swap_manager_t *man, vma_set_t *set)
+{
+    uint64_t start = rdtsc();
+    page_t *page;
+    pte_t *ptep;
+    
+    if (man->swapOut(set, &page, 0) != 0) {
+        panic("%s found no victim", man->name);
+    }
+    
+    sim_stat.ncycle += rdtsc() - start;
+    
+    ptep = get_pte(set->pgdir, page->pra_vaddr, 0);
+    assert(ptep && pte2page(*ptep) == page);
+    
+    size_t vpn = PAGE_NUMBER(page->pra_vaddr - SIM_BASE);
+    
+    if ((*ptep & PTE_FLAG_D) || !sim_disk[vpn]) {
+        sim_disk[vpn] = 1;
+        sim_stat.nwrite++;
+    }
+    
+    *ptep = 0;
+    set->nresident--;
+    
+    sim_free[sim_nfree++] = page;
+}
+
+static void sim_fault(swap_manager_t *man, vma_set_t *set, uintptr_t addr, pte_t *ptep)
+{
+    size_t vpn = PAGE_NUMBER(addr - SIM_BASE);
+    bool swap_in = sim_disk[vpn];
+    page_t *page;
+    
+    sim_stat.nfault++;
+    sim_stat.nread += swap_in;
+    
+    if (!sim_nfree) {
+        sim_evict(man, set);
+    }
+    
+    page = sim_free[--sim_nfree];
+    page_clearFlags(page);
+    page_setSwap(page);
+    page->pra_vaddr = addr;
+    
+    *ptep = page2pa(page) | PTE_FLAG_USER;
+    set->nresident++;
+    
+    uint64_t start = rdtsc();
+    man->mapSwappable(set, addr, page, swap_in);
+    sim_stat.ncycle += rdtsc() - start;
+}
+
+// replay trace with man and nframe frames, a tick every tick accesses(none for 0)
+static void sim_run(swap_manager_t *man, sim_trace_t *trace, size_t nframe, size_t tick)
+{
+    void *mark = host_mark();
+    vma_set_t set;
+    vma_t vma;
+    size_t i;
+    
+    sim_setup(&set, &vma, trace->hdr.npage, nframe);
+    
+    if (man->init() != 0 || man->initVMASet(&set) != 0) {
+        panic("%s failed to init", man->name);
+    }
+    
+    for (i = 0; i < trace->hdr.naccess; i++) {
+        uint32_t rec = trace->rec[i];
+        uintptr_t addr = SIM_BASE + SIM_REC_VPN(rec) * PAGE_SIZE;
+        pte_t *ptep = get_pte(set.pgdir, addr, 1);
+    
+        if (!(*ptep & PTE_FLAG_P)) {
+            sim_fault(man, &set, addr, ptep);
+        }
+    
+        *ptep |= PTE_FLAG_A | (SIM_REC_WRITE(rec) ? PTE_FLAG_D : 0);
+    
+        if (tick && (i + 1) % tick == 0) {
+            uint64_t start = rdtsc();
+            man->tick(&set);
+            sim_stat.ncycle += rdtsc() - start;
+        }
+    }
+    
+    man->exitVMASet(&set);
+    
+    uint64_t per_fault = sim_stat.ncycle;
+    do_div(per_fault, sim_stat.nfault ? sim_stat.nfault : 1);
+    
+    host_printf("%-20s %9d %9d %9d %12llu %10llu\n", man->name,
+                sim_stat.nfault, sim_stat.nread, sim_stat.nwrite,
+                sim_stat.ncycle >> 10, per_fault);
+    
+    host_release(mark);
+}
+
+static void sim_report(sim_trace_t *trace, const char *name, size_t nframe,
+                       size_t tick, const char *only)
+{
+    size_t i;
+    
+    host_printf("%s: %d pages, %d accesses, %d frames, tick every %d accesses\n",
+                name, trace->hdr.npage, trace->hdr.naccess, nframe, tick);
+    host_printf("%-20s %9s %9s %9s %12s %10s\n",
+                "policy", "faults", "reads", "writes", "kcycles", "cyc/fault");
+    
+    for (i = 0; i < C0RE_ARRLEN(sim_mans); i++) {
+        if (!only || strncmp(sim_mans[i]->name, only, strlen(only)) == 0) {
+            sim_run(sim_mans[i], trace, nframe, tick);
+        }
+    }
+    
+    host_printf("\n");
+}
+
+static int sim_load(sim_trace_t *trace, const char *path)
+{
+    int fd = host_open(path, HOST_O_RDONLY, 0), size;
+    
+    if (fd < 0) {
+        host_printf("swapsim: can't open %s\n", path);
+        return -1;
+    }
+    
+    size = host_size(fd);
+    
+    if (size < (int)sizeof(trace->hdr) ||
+        host_read(fd, &(trace->hdr), sizeof(trace->hdr)) < 0 ||
+        trace->hdr.magic != SIM_TRACE_MAGIC ||
+        size - sizeof(trace->hdr) != trace->hdr.naccess * sizeof(*trace->rec)) {
+        host_printf("swapsim: %s is not a trace\n", path);
+        host_close(fd);
+        return -1;
+    }
+    
+    trace->rec = host_alloc(trace->hdr.naccess * sizeof(*trace->rec));
+    
+    if (host_read(fd, trace->rec, trace->hdr.naccess * sizeof(*trace->rec)) < 0) {
+        host_printf("swapsim: failed to read %s\n", path);
+        host_close(fd);
+        return -1;
+    }
+    
+    host_close(fd);
+    
+    for (size = 0; size < (int)trace->hdr.naccess; size++) {
+        if (SIM_REC_VPN(trace->rec[size]) >= trace->hdr.npage) {
+            host_printf("swapsim: access %d of %s is out of its %d pages\n",
+                        size, path, trace->hdr.npage);
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+static int sim_save(sim_trace_t *trace, const char *path)
+{
+    int fd = host_open(path, HOST_O_WRONLY | HOST_O_CREAT | HOST_O_TRUNC, 0644);
+    
+    if (fd < 0 ||
+        host_write(fd, &(trace->hdr), sizeof(trace->hdr)) < 0 ||
+        host_write(fd, trace->rec, trace->hdr.naccess * sizeof(*trace->rec)) < 0) {
+        host_printf("swapsim: failed to write %s\n", path);
+        return -1;
+    }
+    
+    host_close(fd);
+    
+    return 0;
+}
+
+static void sim_usage()
+{
+    host_printf("usage: swapsim gen <loop|zipf|scan> <file> [npage [naccess]]\n"
+                "       swapsim run <file> [-f nframe] [-t tick] [-p policy] [-v]\n"
+                "       swapsim bench [npage [naccess]]\n"
+                "nframe defaults to npage/4, tick to %d accesses(0 for none),\n"
+                "policy is one of fifo, clock, arc, mglru\n", SIM_DEFAULT_TICK);
+}
+
+// parse the optional npage and naccess at argv[0] and argv[1]
+static void sim_size(int argc, char **argv, size_t *npage, size_t *naccess)
+{
+    *npage = argc > 0 ? strtol(argv[0], NULL, 10) : SIM_DEFAULT_NPAGE;
+    *naccess = argc > 1 ? strtol(argv[1], NULL, 10) : SIM_DEFAULT_NACCESS;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *patterns[] = { "loop", "zipf", "scan" };
+    size_t npage, naccess, nframe = 0, tick = SIM_DEFAULT_TICK, i;
+    const char *only = NULL;
+    sim_trace_t trace;
+    
+    if (argc >= 4 && strcmp(argv[1], "gen") == 0) {
+        sim_size(argc - 4, argv + 4, &npage, &naccess);
+    
+        if (sim_gen(&trace, argv[2], npage, naccess) != 0) {
+            sim_usage();
+            return 1;
+        }
+    
+        return sim_save(&trace, argv[3]) != 0;
+    }
+    
+    if (argc >= 3 && strcmp(argv[1], "run") == 0) {
+        for (i = 3; i < (size_t)argc; i++) {
+            if (strcmp(argv[i], "-v") == 0) {
+                sim_verbose = 1;
+            } else if (i + 1 < (size_t)argc && strcmp(argv[i], "-f") == 0) {
+                nframe = strtol(argv[++i], NULL, 10);
+            } else if (i + 1 < (size_t)argc && strcmp(argv[i], "-t") == 0) {
+                tick = strtol(argv[++i], NULL, 10);
+            } else if (i + 1 < (size_t)argc && strcmp(argv[i], "-p") == 0) {
+                only = argv[++i];
+            } else {
+                sim_usage();
+                return 1;
+            }
+        }
+    
+        if (sim_load(&trace, argv[2]) != 0) {
+            return 1;
+        }
+    
+        sim_report(&trace, argv[2], nframe ? nframe : trace.hdr.npage / 4, tick, only);
+    
+        return 0;
+    }
+    
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        sim_size(argc - 2, argv + 2, &npage, &naccess);
+    
+        for (i = 0; i < C0RE_ARRLEN(patterns); i++) {
+            void *mark = host_mark();
+    
+            if (sim_gen(&trace, patterns[i], npage, naccess) != 0) {
+                sim_usage();
+                return 1;
+            }
+    
+            sim_report(&trace, patterns[i], npage / 4, tick, NULL);
+            host_release(mark);
+        }
+    
+        return 0;
+    }
+    
+    sim_usage();
+    
+    return 1;
+}
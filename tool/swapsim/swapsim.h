@@ -0,0 +1,62 @@
+#ifndef _TOOL_SWAPSIM_SWAPSIM_H_
+#define _TOOL_SWAPSIM_SWAPSIM_H_
+
+/**
+ * swapsim - replays memory access traces against the swap managers of
+ * kernel/mem, built with the kernel's own flags and headers and run as a
+ * bare i386 linux program(no libc), see host.c
+ **/
+
+#include "pub/com.h"
+#include "pub/stdarg.h"
+
+/**
+ * a trace file is a header followed by naccess records of 32 bits, all
+ * little endian. a record is (vpn << 1 | write), vpn is the page number
+ * from the start of the traced area, less than npage.
+ **/
+#define SIM_TRACE_MAGIC     0x52543043 // "C0TR"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t npage;
+    uint32_t naccess;
+} sim_trace_hdr_t;
+
+#define SIM_REC(vpn, write) ((uint32_t)(vpn) << 1 | ((write) ? 1 : 0))
+#define SIM_REC_VPN(rec)    ((rec) >> 1)
+#define SIM_REC_WRITE(rec)  ((rec) & 1)
+
+typedef struct {
+    sim_trace_hdr_t hdr;
+    uint32_t *rec;
+} sim_trace_t;
+
+/* host.c: the few system calls needed */
+
+#define HOST_O_RDONLY   0
+#define HOST_O_WRONLY   01
+#define HOST_O_CREAT    0100
+#define HOST_O_TRUNC    01000
+
+void host_exit(int code) C0RE_NORETURN;
+int host_open(const char *path, int flags, int mode);
+int host_close(int fd);
+int host_read(int fd, void *buf, size_t n);
+int host_write(int fd, const void *buf, size_t n);
+int host_size(int fd);
+
+void *host_alloc(size_t n);
+void *host_mark();
+void host_release(void *mark);
+
+int host_printf(const char *fmt, ...);
+int host_vprintf(const char *fmt, va_list ap);
+
+/* gen.c: trace generators */
+
+#define SIM_WRITE_PERCENT 25 // of generated accesses
+
+int sim_gen(sim_trace_t *trace, const char *pattern, size_t npage, size_t naccess);
+
+#endif